@@ -0,0 +1,148 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file BackgroundJob.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Running long actions of a polyscope GUI on a worker thread. A job
+ * computes its results on the worker, reporting its progress and
+ * checking for cancellation; then its completion function, which may
+ * register structures in polyscope, is called on the GUI thread.
+ *
+ * While a job runs, the GUI callback should only display its status
+ * (see jobStatus): the data used by the job belongs to it.
+ */
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <thread>
+
+#include "imgui.h"
+
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// What a job sees of its worker.
+  class JobControl
+  {
+  public:
+    /// Reports that a fraction \a p (in [0,1]) of the job is done.
+    void setProgress( double p ) { my_progress = p; }
+    double progress() const { return my_progress; }
+
+    /// @return 'true' if the user asked to stop. The job should then
+    /// return as soon as its data are in a consistent state.
+    bool isCancelled() const { return my_cancelled; }
+    void cancel() { my_cancelled = true; }
+
+    /// @return the flag raised on cancellation, to be checked by the
+    /// loops of the job (see isStopped).
+    const StopFlag* stopFlag() const { return &my_cancelled; }
+
+    void reset() { my_progress = 0.0; my_cancelled = false; }
+
+  private:
+    std::atomic< double > my_progress  { 0.0 };
+    StopFlag              my_cancelled { false };
+  };
+
+  /// Runs one job at a time on a worker thread.
+  class BackgroundWorker
+  {
+  public:
+    /// A job. It returns 'false' if it stopped early (cancelled) or
+    /// failed, in which case its completion function is not called.
+    typedef std::function< bool( JobControl& ) > Work;
+    /// What to do on the GUI thread once the job is done.
+    typedef std::function< void() >              Done;
+
+    BackgroundWorker() = default;
+    ~BackgroundWorker() { if ( my_thread.joinable() ) { my_control.cancel(); my_thread.join(); } }
+    BackgroundWorker( const BackgroundWorker& ) = delete;
+    BackgroundWorker& operator=( const BackgroundWorker& ) = delete;
+
+    /// Starts \a work on the worker thread, unless a job is running.
+    /// @return 'true' if the job was started.
+    bool start( const std::string& name, Work work, Done done = Done() )
+    {
+      if ( busy() ) return false;
+      my_name     = name;
+      my_done     = std::move( done );
+      my_finished = false;
+      my_success  = false;
+      my_control.reset();
+      my_thread = std::thread( [this, work] {
+        my_success  = work( my_control );
+        my_finished = true;
+      } );
+      return true;
+    }
+
+    /// @return 'true' while a job is running or waits for poll.
+    bool busy() const { return my_thread.joinable(); }
+
+    const std::string& name() const { return my_name; }
+    double progress() const { return my_control.progress(); }
+    bool isCancelled() const { return my_control.isCancelled(); }
+
+    /// Asks the running job to stop.
+    void cancel() { my_control.cancel(); }
+
+    /// To be called by the GUI thread: if the job is over, joins it and
+    /// calls its completion function.
+    /// @return 'true' if a job is still running (or was started by
+    /// the completion function).
+    bool poll()
+    {
+      if ( ! my_thread.joinable() ) return false;
+      if ( ! my_finished ) return true;
+      my_thread.join();
+      Done done = std::move( my_done ); // which may start another job
+      my_done = Done();
+      if ( my_success && done ) done();
+      return busy();
+    }
+
+  private:
+    std::thread         my_thread;
+    std::string         my_name;
+    Done                my_done;
+    JobControl          my_control;
+    std::atomic< bool > my_finished { false };
+    std::atomic< bool > my_success  { false };
+  };
+
+  /// Displays the job of \a worker (name, progress and a Cancel
+  /// button) and completes it when it is over.
+  /// @return 'true' while a job is running, the rest of the GUI being
+  /// then skipped by the caller.
+  inline bool jobStatus( BackgroundWorker& worker )
+  {
+    if ( ! worker.poll() ) return false;
+    ImGui::Text( "%s", worker.name().c_str() );
+    ImGui::ProgressBar( float( worker.progress() ) );
+    if ( worker.isCancelled() )
+      ImGui::Text( "Cancelling..." );
+    else if ( ImGui::Button( "Cancel" ) )
+      worker.cancel();
+    return true;
+  }
+} // namespace IPCV
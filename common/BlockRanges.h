@@ -0,0 +1,270 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file BlockRanges.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Min/max pyramid of the blocks of 8^3 voxels of a gray-scale volume,
+ * so that surface extractions at threshold t only visit the blocks
+ * having values both <= t and > t.
+ *
+ * Block (bx,by,bz) covers voxels 8bx to 8bx+8 (included) along x, and
+ * similarly along y and z: it contains both voxels of each edge and
+ * the 8 corners of each cube whose lowest voxel is in [8bx,8bx+8) x
+ * [8by,8by+8) x [8bz,8bz+8). A surfel or a cube whose lowest voxel
+ * lies in an inactive block is thus never on the surface.
+ *
+ * The ranges are keyed on the generation of the image (see
+ * ImageGenerations). After a min or max filter of radius r (erosion,
+ * dilation, closing...), only the blocks whose r-neighborhood was not
+ * made of constant blocks of the same value may have changed, and
+ * only those are recomputed.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/ImageGenerations.h"
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// The blocks of a volume that straddle a threshold.
+  struct BlockMask
+  {
+    static constexpr std::size_t SHIFT = 3; // blocks of 8 voxels along each axis
+
+    Extent                       blocks { 0, 0, 0 }; // number of blocks along each axis
+    std::vector< unsigned char > active;             // one per block, x fastest
+
+    /// @return 'true' if the block of the voxel (x,y,z) is active.
+    bool isActive( std::size_t x, std::size_t y, std::size_t z ) const
+    {
+      return active[ ( ( z >> SHIFT ) * blocks.ny + ( y >> SHIFT ) ) * blocks.nx
+                     + ( x >> SHIFT ) ];
+    }
+
+    /// @return the first voxel of row (y,z), from \a x and before \a n,
+    /// that lies in an active block, or \a n if there is none.
+    std::size_t nextActive( std::size_t x, std::size_t y, std::size_t z, std::size_t n ) const
+    {
+      while ( x < n && ! isActive( x, y, z ) ) x = ( ( x >> SHIFT ) + 1 ) << SHIFT;
+      return std::min( x, n );
+    }
+
+    /// @return the number of active blocks.
+    std::size_t count() const
+    { return std::size_t( std::count( active.begin(), active.end(), 1 ) ); }
+  };
+
+  /// Same as BlockMask::nextActive, every voxel being active if \a
+  /// blocks is null.
+  inline std::size_t nextActive( const BlockMask* blocks, std::size_t x, std::size_t y,
+                                 std::size_t z, std::size_t n )
+  {
+    return blocks == nullptr ? x : blocks->nextActive( x, y, z, n );
+  }
+
+  /// The min/max values of the blocks of a volume, and of groups of
+  /// 2^k x 2^k x 2^k blocks.
+  class BlockRanges
+  {
+  public:
+    static constexpr std::size_t B = std::size_t( 1 ) << BlockMask::SHIFT;
+
+    /// Computes the ranges of the volume \a data of extent \a e and of
+    /// generation \a generation, which must outlive this object, with
+    /// the threads of \a pool.
+    void init( const unsigned char* data, Extent e, std::uint64_t generation, ThreadPool& pool )
+    {
+      my_data       = data;
+      my_generation = generation;
+      my_extent     = e;
+      my_blocks = Extent { ( e.nx + B - 1 ) / B, ( e.ny + B - 1 ) / B, ( e.nz + B - 1 ) / B };
+      my_levels.assign( 1, Level { my_blocks, std::vector< unsigned char >( 2 * my_blocks.size() ) } );
+      my_dirty.assign( my_blocks.size(), 1 );
+      my_nb_dirty = my_blocks.size();
+      update( pool );
+    }
+
+    /// @return 'true' if the ranges are the ones of the image of
+    /// generation \a generation.
+    bool isValid( std::uint64_t generation ) const
+    { return my_generation != ImageGenerations::NONE && my_generation == generation; }
+
+    /// Tells that the whole volume has been modified in place, and has
+    /// now generation \a generation.
+    void invalidate( std::uint64_t generation )
+    {
+      my_generation = generation;
+      std::fill( my_dirty.begin(), my_dirty.end(), 1 );
+      my_nb_dirty = my_dirty.size();
+    }
+
+    /// Tells that the volume has been modified in place by min or max
+    /// filters whose output voxels only depend on the input voxels
+    /// within distance \a r (L-infinity), like a dilation or an
+    /// erosion of radius r, or a closing of radius r/2. The volume has
+    /// now generation \a generation. A block can only change if some
+    /// block within distance r of its voxels is not constant, or
+    /// constant with another value.
+    void invalidateFiltered( std::size_t r, std::uint64_t generation )
+    {
+      my_generation = generation;
+      // constant[ b ] is the value of block b if it is constant and up
+      // to date, -1 otherwise. It becomes, axis after axis, the value
+      // shared by the blocks of the r-neighborhood of b.
+      const unsigned char* range = my_levels[ 0 ].range.data();
+      std::vector< int > constant( my_blocks.size() ), tmp( my_blocks.size() );
+      for ( std::size_t b = 0; b < my_blocks.size(); b++ )
+        constant[ b ] = ! my_dirty[ b ] && range[ 2 * b ] == range[ 2 * b + 1 ]
+          ? int( range[ 2 * b ] ) : -1;
+      const std::size_t n[ 3 ]      = { my_extent.nx, my_extent.ny, my_extent.nz };
+      const std::size_t nb[ 3 ]     = { my_blocks.nx, my_blocks.ny, my_blocks.nz };
+      const std::size_t stride[ 3 ] = { 1, my_blocks.nx, my_blocks.nx * my_blocks.ny };
+      for ( int a = 0; a < 3; a++ )
+        {
+          for ( std::size_t b = 0; b < my_blocks.size(); b++ )
+            {
+              const std::size_t i  = ( b / stride[ a ] ) % nb[ a ];
+              // Voxels [v0,v1] of the neighborhood, covered by blocks v0/B to c1.
+              const std::size_t v0 = i * B > r ? i * B - r : 0;
+              const std::size_t v1 = std::min( i * B + B + r, n[ a ] - 1 );
+              const std::size_t c1 = std::min( v1 / B, nb[ a ] - 1 );
+              int value = constant[ b ];
+              for ( std::size_t c = v0 / B; c <= c1 && value >= 0; c++ )
+                if ( constant[ b + c * stride[ a ] - i * stride[ a ] ] != value ) value = -1;
+              tmp[ b ] = value;
+            }
+          constant.swap( tmp );
+        }
+      for ( std::size_t b = 0; b < my_blocks.size(); b++ )
+        if ( constant[ b ] < 0 && ! my_dirty[ b ] ) { my_dirty[ b ] = 1; my_nb_dirty++; }
+    }
+
+    /// Recomputes the ranges of the modified blocks, and the pyramid.
+    void update( ThreadPool& pool )
+    {
+      if ( my_nb_dirty == 0 ) return;
+      pool.parallelFor( 0, my_blocks.nz, [&] ( std::size_t z0, std::size_t z1, std::size_t )
+      {
+        for ( std::size_t bz = z0; bz < z1; bz++ )
+          for ( std::size_t by = 0; by < my_blocks.ny; by++ )
+            for ( std::size_t bx = 0; bx < my_blocks.nx; bx++ )
+              {
+                const std::size_t b = ( bz * my_blocks.ny + by ) * my_blocks.nx + bx;
+                if ( my_dirty[ b ] ) computeBlock( bx, by, bz, my_levels[ 0 ].range.data() + 2 * b );
+                my_dirty[ b ] = 0;
+              }
+      } );
+      my_nb_dirty = 0;
+      my_levels.resize( 1 );
+      while ( my_levels.back().size.size() > 1 ) my_levels.push_back( coarsen( my_levels.back() ) );
+    }
+
+    /// @return the blocks having values <= t and > t, found by
+    /// descending the pyramid from its top. update() must have been
+    /// called since the last invalidation.
+    BlockMask activeBlocks( int t ) const
+    {
+      BlockMask mask;
+      mask.blocks = my_blocks;
+      mask.active.assign( my_blocks.size(), 0 );
+      if ( ! my_levels.empty() ) descend( my_levels.size() - 1, 0, 0, 0, t, mask );
+      return mask;
+    }
+
+  private:
+    struct Level {
+      Extent                       size;  // nodes along each axis
+      std::vector< unsigned char > range; // min, max of each node
+    };
+
+    /// Min/max of voxels [8b,8b+8] along each axis.
+    void computeBlock( std::size_t bx, std::size_t by, std::size_t bz, unsigned char* range ) const
+    {
+      const std::size_t x0 = bx * B, x1 = std::min( x0 + B + 1, my_extent.nx );
+      const std::size_t y0 = by * B, y1 = std::min( y0 + B + 1, my_extent.ny );
+      const std::size_t z0 = bz * B, z1 = std::min( z0 + B + 1, my_extent.nz );
+      unsigned char m = 255, M = 0;
+      for ( std::size_t z = z0; z < z1; z++ )
+        for ( std::size_t y = y0; y < y1; y++ )
+          {
+            const unsigned char* row = my_data + ( z * my_extent.ny + y ) * my_extent.nx;
+            for ( std::size_t x = x0; x < x1; x++ )
+              { m = std::min( m, row[ x ] ); M = std::max( M, row[ x ] ); }
+          }
+      range[ 0 ] = m;
+      range[ 1 ] = M;
+    }
+
+    /// @return the level made of groups of 2x2x2 nodes of \a fine.
+    static Level coarsen( const Level& fine )
+    {
+      const Extent& f = fine.size;
+      Level coarse { Extent { ( f.nx + 1 ) / 2, ( f.ny + 1 ) / 2, ( f.nz + 1 ) / 2 }, {} };
+      const Extent& c = coarse.size;
+      coarse.range.resize( 2 * c.size() );
+      for ( std::size_t z = 0; z < c.nz; z++ )
+        for ( std::size_t y = 0; y < c.ny; y++ )
+          for ( std::size_t x = 0; x < c.nx; x++ )
+            {
+              unsigned char m = 255, M = 0;
+              for ( std::size_t k = 2 * z; k < std::min( 2 * z + 2, f.nz ); k++ )
+                for ( std::size_t j = 2 * y; j < std::min( 2 * y + 2, f.ny ); j++ )
+                  for ( std::size_t i = 2 * x; i < std::min( 2 * x + 2, f.nx ); i++ )
+                    {
+                      const unsigned char* r = fine.range.data() + 2 * ( ( k * f.ny + j ) * f.nx + i );
+                      m = std::min( m, r[ 0 ] ); M = std::max( M, r[ 1 ] );
+                    }
+              unsigned char* r = coarse.range.data() + 2 * ( ( z * c.ny + y ) * c.nx + x );
+              r[ 0 ] = m; r[ 1 ] = M;
+            }
+      return coarse;
+    }
+
+    /// Marks the active blocks below node (x,y,z) of level \a l.
+    void descend( std::size_t l, std::size_t x, std::size_t y, std::size_t z,
+                  int t, BlockMask& mask ) const
+    {
+      const Level& L = my_levels[ l ];
+      if ( x >= L.size.nx || y >= L.size.ny || z >= L.size.nz ) return;
+      const unsigned char* r = L.range.data() + 2 * ( ( z * L.size.ny + y ) * L.size.nx + x );
+      if ( ! ( int( r[ 0 ] ) <= t && t < int( r[ 1 ] ) ) ) return;
+      if ( l == 0 )
+        {
+          mask.active[ ( z * my_blocks.ny + y ) * my_blocks.nx + x ] = 1;
+          return;
+        }
+      for ( std::size_t k = 0; k < 8; k++ )
+        descend( l - 1, 2 * x + ( k & 1 ), 2 * y + ( ( k >> 1 ) & 1 ), 2 * z + ( k >> 2 ), t, mask );
+    }
+
+    const unsigned char*         my_data       = nullptr;
+    std::uint64_t                my_generation = ImageGenerations::NONE;
+    Extent                       my_extent { 0, 0, 0 };
+    Extent                       my_blocks { 0, 0, 0 };
+    std::vector< Level >         my_levels; // blocks, then coarser and coarser
+    std::vector< unsigned char > my_dirty;  // blocks to recompute
+    std::size_t                  my_nb_dirty = 0;
+  };
+} // namespace IPCV
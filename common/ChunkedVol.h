@@ -0,0 +1,209 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file ChunkedVol.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Parallel writing of compressed .vol files (Version 3). The volume is
+ * cut into blocks of z-slices that are deflated independently by
+ * several threads, each block ending on a byte boundary (sync flush).
+ * Their concatenation, framed by the zlib header and the adler32 of
+ * the whole data, is a single valid zlib stream, so the file is read
+ * as usual by DGtal.
+ *
+ * The offsets of the blocks are written in a companion index file
+ * (name of the .vol file followed by ".idx"). Since a block does not
+ * refer to previous ones, ChunkedVolReader can inflate any block
+ * alone and skip the others.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+#include "common/VolStream.h"
+
+namespace IPCV
+{
+  /// The positions of the compressed blocks of a .vol file.
+  struct VolBlockIndex {
+    std::size_t                  block_slices = 0; ///< z-slices per block
+    std::vector< std::uint64_t > offsets;          ///< from the beginning of the file
+    std::vector< std::uint64_t > sizes;            ///< compressed sizes
+
+    /// Reads the index file \a filename. @return 'true' if it is valid.
+    bool read( const std::string& filename )
+    {
+      std::ifstream in( filename );
+      std::string   magic, key;
+      std::size_t   nb = 0;
+      in >> magic >> key >> block_slices >> key >> nb;
+      if ( ! in || magic != "IPCV-VOLIDX-1" || block_slices == 0 ) return false;
+      offsets.resize( nb );
+      sizes.resize( nb );
+      for ( std::size_t i = 0; i < nb; i++ ) in >> offsets[ i ] >> sizes[ i ];
+      return bool( in );
+    }
+
+    /// Writes the index file \a filename. @return 'true' if ok.
+    bool write( const std::string& filename ) const
+    {
+      std::ofstream out( filename );
+      out << "IPCV-VOLIDX-1\n" << "slices: " << block_slices << "\n"
+          << "blocks: " << offsets.size() << "\n";
+      for ( std::size_t i = 0; i < offsets.size(); i++ )
+        out << offsets[ i ] << " " << sizes[ i ] << "\n";
+      out.close();
+      return ! out.fail();
+    }
+  };
+
+  /// Saves the volume \a data of extent \a e as a compressed .vol file
+  /// \a filename, blocks of \a block_slices z-slices being compressed
+  /// in parallel by the threads of \a pool. Also writes the block index
+  /// in filename + ".idx". If \a stop is raised while blocks are
+  /// compressed, nothing is written.
+  /// @return 'true' if everything was written.
+  inline bool saveChunkedVol( const unsigned char* data, Extent e,
+                              const std::string& filename, ThreadPool& pool,
+                              std::size_t block_slices = 16,
+                              int level = Z_DEFAULT_COMPRESSION,
+                              const StopFlag* stop = nullptr )
+  {
+    block_slices = std::max( block_slices, std::size_t( 1 ) );
+    const std::size_t S  = e.nx * e.ny;
+    const std::size_t nb = ( e.nz + block_slices - 1 ) / block_slices;
+    std::vector< std::vector< unsigned char > > blocks( nb );
+    std::vector< uLong > checksums( nb );
+    std::vector< char >  failed( nb, 0 );
+    pool.parallelFor( 0, nb, [&] ( std::size_t b0, std::size_t b1, std::size_t )
+    {
+      for ( std::size_t b = b0; b < b1 && ! isStopped( stop ); b++ )
+        {
+          const std::size_t z0    = b * block_slices;
+          const std::size_t z1    = std::min( e.nz, z0 + block_slices );
+          const std::size_t bytes = ( z1 - z0 ) * S;
+          const unsigned char* in = data + z0 * S;
+          z_stream zs = z_stream();
+          // Raw deflate (no zlib header): blocks are framed below.
+          if ( deflateInit2( &zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+            { failed[ b ] = 1; continue; }
+          auto& out = blocks[ b ];
+          out.resize( deflateBound( &zs, uLong( bytes ) ) + 16 );
+          zs.next_in   = const_cast< unsigned char* >( in );
+          zs.avail_in  = uInt( bytes );
+          zs.next_out  = out.data();
+          zs.avail_out = uInt( out.size() );
+          const int status = deflate( &zs, b + 1 == nb ? Z_FINISH : Z_SYNC_FLUSH );
+          if ( ( b + 1 == nb && status != Z_STREAM_END )
+               || ( b + 1 != nb && status != Z_OK ) || zs.avail_in != 0 )
+            failed[ b ] = 1;
+          out.resize( out.size() - zs.avail_out );
+          deflateEnd( &zs );
+          checksums[ b ] = adler32( adler32( 0L, Z_NULL, 0 ), in, uInt( bytes ) );
+        }
+    } );
+    if ( isStopped( stop ) ) return false;
+    for ( auto f : failed ) if ( f ) return false;
+    std::ofstream out( filename, std::ios::binary );
+    VolHeader header;
+    header.nx = e.nx; header.ny = e.ny; header.nz = e.nz; header.version = 3;
+    header.write( out );
+    const unsigned char zheader[ 2 ] = { 0x78, 0x9c };
+    out.write( reinterpret_cast< const char* >( zheader ), 2 );
+    VolBlockIndex index;
+    index.block_slices = block_slices;
+    uLong adler = adler32( 0L, Z_NULL, 0 );
+    for ( std::size_t b = 0; b < nb; b++ )
+      {
+        index.offsets.push_back( std::uint64_t( out.tellp() ) );
+        index.sizes.push_back( blocks[ b ].size() );
+        out.write( reinterpret_cast< const char* >( blocks[ b ].data() ), blocks[ b ].size() );
+        const std::size_t z0 = b * block_slices;
+        const std::size_t z1 = std::min( e.nz, z0 + block_slices );
+        adler = adler32_combine( adler, checksums[ b ], z_off_t( ( z1 - z0 ) * S ) );
+      }
+    const unsigned char trailer[ 4 ] = {
+      (unsigned char)( adler >> 24 ), (unsigned char)( adler >> 16 ),
+      (unsigned char)( adler >> 8 ),  (unsigned char)( adler ) };
+    out.write( reinterpret_cast< const char* >( trailer ), 4 );
+    out.close();
+    return ! out.fail() && index.write( filename + ".idx" );
+  }
+
+  /// Reads any block of z-slices of a .vol file written by saveChunkedVol.
+  class ChunkedVolReader
+  {
+  public:
+    /// Opens \a filename and its index. @return 'true' if both are valid.
+    bool open( const std::string& filename )
+    {
+      my_in.open( filename, std::ios::binary );
+      return my_in.good() && my_header.read( my_in ) && my_header.version == 3
+        && my_index.read( filename + ".idx" )
+        && nbBlocks() == ( my_header.nz + my_index.block_slices - 1 ) / my_index.block_slices;
+    }
+
+    const VolHeader& header() const { return my_header; }
+    std::size_t nbBlocks() const { return my_index.offsets.size(); }
+
+    /// @return the first z-slice of block \a b.
+    std::size_t firstSlice( std::size_t b ) const { return b * my_index.block_slices; }
+
+    /// @return the number of z-slices of block \a b.
+    std::size_t nbSlices( std::size_t b ) const
+    {
+      return std::min( my_header.nz, firstSlice( b ) + my_index.block_slices ) - firstSlice( b );
+    }
+
+    /// Inflates block \a b into \a buffer, which must have room for
+    /// nbSlices( b ) z-slices. @return 'true' if ok.
+    bool readBlock( std::size_t b, unsigned char* buffer )
+    {
+      std::vector< unsigned char > input( my_index.sizes[ b ] );
+      my_in.clear();
+      my_in.seekg( std::streamoff( my_index.offsets[ b ] ) );
+      my_in.read( reinterpret_cast< char* >( input.data() ), input.size() );
+      if ( std::size_t( my_in.gcount() ) != input.size() ) return false;
+      z_stream zs = z_stream();
+      if ( inflateInit2( &zs, -15 ) != Z_OK ) return false;
+      const std::size_t bytes = nbSlices( b ) * my_header.sliceSize();
+      zs.next_in   = input.data();
+      zs.avail_in  = uInt( input.size() );
+      zs.next_out  = buffer;
+      zs.avail_out = uInt( bytes );
+      const int status = inflate( &zs, Z_SYNC_FLUSH );
+      const bool ok = ( status == Z_OK || status == Z_STREAM_END ) && zs.avail_out == 0;
+      inflateEnd( &zs );
+      return ok;
+    }
+
+  private:
+    std::ifstream my_in;
+    VolHeader     my_header;
+    VolBlockIndex my_index;
+  };
+} // namespace IPCV
@@ -0,0 +1,80 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file FlatMesh.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Meshes whose faces all have the same number of vertices, stored as
+ * one contiguous array of vertex indices (nbFaces x N). They are given
+ * as is to polyscope::registerSurfaceMesh and to the SurfaceMesh
+ * constructor, instead of converting each face to a std::vector.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <vector>
+
+namespace IPCV
+{
+  /// A mesh with N vertices per face.
+  /// @tparam TRealPoint the type of the vertex positions.
+  template < typename TRealPoint, std::size_t N >
+  struct FlatMesh
+  {
+    typedef TRealPoint                  RealPoint;
+    typedef std::array< std::size_t, N > Face;
+
+    std::vector< RealPoint > positions;
+    std::vector< Face >      faces;
+
+    std::size_t nbFaces() const { return faces.size(); }
+
+    /// @return the N x nbFaces() vertex indices.
+    const std::size_t* indices() const { return faces.empty() ? nullptr : faces[ 0 ].data(); }
+
+    void clear() { positions.clear(); faces.clear(); }
+
+    /// Appends the vertices and faces of \a mesh, a DGtal SurfaceMesh
+    /// (like the primal surface of SH3::makePrimalSurfaceMesh) whose
+    /// faces have N vertices.
+    template < typename TSurfaceMesh >
+    void append( const TSurfaceMesh& mesh )
+    {
+      const std::size_t offset = positions.size();
+      const std::size_t first  = faces.size();
+      const auto& pos = mesh.positions();
+      positions.insert( positions.end(), pos.begin(), pos.end() );
+      faces.resize( first + mesh.nbFaces() );
+      for ( std::size_t f = 0; f < mesh.nbFaces(); f++ )
+        {
+          const auto& vertices = mesh.incidentVertices( f );
+          Face& face = faces[ first + f ];
+          for ( std::size_t i = 0; i < N; i++ ) face[ i ] = offset + vertices[ i ];
+        }
+    }
+  };
+
+  /// The primal surfaces of digital surfaces.
+  template < typename TRealPoint >
+  using QuadMesh = FlatMesh< TRealPoint, 4 >;
+
+  /// Triangulated surfaces, like isosurfaces.
+  template < typename TRealPoint >
+  using TriangleMesh = FlatMesh< TRealPoint, 3 >;
+} // namespace IPCV
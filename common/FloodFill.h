@@ -0,0 +1,250 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file FloodFill.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Flood filling of 3d images of unsigned char along 6-neighbors: the
+ * voxels of value 0 connected to the seeds are set to 255, any other
+ * value being a wall that the filling cannot cross.
+ *
+ * The sequential version fills whole spans of rows (scanline fill),
+ * and only pushes one voxel per run of empty voxels of the
+ * neighboring rows. The parallel version processes a frontier of
+ * spans level by level: each thread claims voxels with an atomic
+ * compare-exchange, extends its spans along their row, and pushes the
+ * runs it claims in the y- and z-neighbor rows in its own next
+ * frontier.
+ *
+ * For closed surfaces, parityFill gives the same result without any
+ * queue over voxels: the surfels orthogonal to x cut each row into
+ * runs that are entirely on one side, and the rows crossed by no such
+ * surfel take the side of their neighbor rows.
+ *
+ * All fills stop early if their StopFlag is raised, leaving the
+ * volume partially filled.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  namespace details
+  {
+    /// Calls f( r ) for the offsets r of the rows that are y- and
+    /// z-neighbors of the row starting at offset \a row.
+    template < typename Function >
+    void forNeighborRows( std::size_t row, Extent e, Function f )
+    {
+      const std::size_t slice = e.nx * e.ny;
+      const std::size_t y     = ( row / e.nx ) % e.ny;
+      const std::size_t z     = row / slice;
+      if ( y > 0 )        f( row - e.nx );
+      if ( y + 1 < e.ny ) f( row + e.nx );
+      if ( z > 0 )        f( row - slice );
+      if ( z + 1 < e.nz ) f( row + slice );
+    }
+  }
+
+  /// Fills sequentially the volume \a data of extent \a e from the
+  /// voxels of indices \a seeds, which must already have value 255.
+  inline void scanlineFill( unsigned char* data, Extent e,
+                            const std::vector< std::size_t >& seeds,
+                            const StopFlag* stop = nullptr )
+  {
+    std::vector< std::size_t > stack;
+    // Fills the row of the filled voxel p, then pushes the first voxel
+    // of each run of empty voxels along the span in the neighbor rows.
+    auto fillSpan = [&] ( std::size_t p )
+    {
+      const std::size_t x   = p % e.nx;
+      const std::size_t row = p - x;
+      unsigned char*    r   = data + row;
+      std::size_t b = x, end = x + 1;
+      while ( b > 0 && r[ b - 1 ] == 0 )      r[ --b ]    = 255;
+      while ( end < e.nx && r[ end ] == 0 )  r[ end++ ] = 255;
+      details::forNeighborRows( row, e, [&] ( std::size_t n )
+      {
+        bool in_run = false;
+        for ( std::size_t i = b; i < end; i++ )
+          {
+            const bool empty = data[ n + i ] == 0;
+            if ( empty && ! in_run ) stack.push_back( n + i );
+            in_run = empty;
+          }
+      } );
+    };
+    for ( auto s : seeds ) fillSpan( s );
+    while ( ! stack.empty() && ! isStopped( stop ) )
+      {
+        const std::size_t p = stack.back();
+        stack.pop_back();
+        if ( data[ p ] != 0 ) continue; // filled by another span meanwhile
+        data[ p ] = 255;
+        fillSpan( p );
+      }
+  }
+
+  /// Fills in parallel with the threads of \a pool the volume \a data
+  /// of extent \a e from the voxels of indices \a seeds, which must
+  /// already have value 255. The result is the same as scanlineFill.
+  inline void frontierFill( unsigned char* data, Extent e,
+                            const std::vector< std::size_t >& seeds, ThreadPool& pool,
+                            const StopFlag* stop = nullptr )
+  {
+    typedef std::atomic_ref< unsigned char > Voxel;
+    // Voxels [row+b,row+end) filled by the same thread.
+    struct Span { std::size_t row, b, end; };
+    // @return 'true' if the calling thread is the one that filled q.
+    auto claim = [data] ( std::size_t q )
+    {
+      Voxel v( data[ q ] );
+      unsigned char empty = 0;
+      return v.load( std::memory_order_relaxed ) == 0
+        && v.compare_exchange_strong( empty, 255, std::memory_order_relaxed );
+    };
+    std::vector< Span > frontier;
+    for ( auto s : seeds ) frontier.push_back( Span { s - s % e.nx, s % e.nx, s % e.nx + 1 } );
+    std::vector< std::vector< Span > > next( pool.size() );
+    while ( ! frontier.empty() && ! isStopped( stop ) )
+      {
+        pool.parallelFor( 0, frontier.size(), [&] ( std::size_t i0, std::size_t i1, std::size_t t )
+        {
+          auto& out = next[ t ];
+          for ( std::size_t i = i0; i < i1; i++ )
+            {
+              Span span = frontier[ i ];
+              while ( span.b > 0 && claim( span.row + span.b - 1 ) )      span.b--;
+              while ( span.end < e.nx && claim( span.row + span.end ) ) span.end++;
+              // The runs of voxels claimed in the neighbor rows are the
+              // spans of the next level.
+              details::forNeighborRows( span.row, e, [&] ( std::size_t n )
+              {
+                for ( std::size_t j = span.b; j < span.end; j++ )
+                  if ( claim( n + j ) )
+                    {
+                      const std::size_t b = j;
+                      while ( j + 1 < span.end && claim( n + j + 1 ) ) j++;
+                      out.push_back( Span { n, b, j + 1 } );
+                    }
+              } );
+            }
+        } );
+        frontier.clear();
+        for ( auto& out : next )
+          {
+            frontier.insert( frontier.end(), out.begin(), out.end() );
+            out.clear();
+          }
+      }
+  }
+
+  /// A surfel orthogonal to x, between voxels x and x+1 of a row.
+  struct RowCrossing {
+    std::size_t row;        ///< offset of the row
+    std::size_t x;
+    bool        fill_right; ///< 'true' if voxel x+1 is on the filled side
+  };
+
+  /// Fills in parallel with the threads of \a pool the volume \a data
+  /// of extent \a e, where the voxels on both sides of closed
+  /// surfaces have already been set to 255 (filled side) and 1
+  /// (wall), and \a crossings are the surfels orthogonal to x. The
+  /// result is the same as the flood fill from the 255 voxels, walls
+  /// being then set back to 0.
+  inline void parityFill( unsigned char* data, Extent e,
+                          std::vector< RowCrossing > crossings, ThreadPool& pool,
+                          const StopFlag* stop = nullptr )
+  {
+    const std::size_t nb_rows = e.ny * e.nz;
+    std::sort( crossings.begin(), crossings.end(), [] ( const RowCrossing& a, const RowCrossing& b )
+               { return a.row < b.row || ( a.row == b.row && a.x < b.x ); } );
+    std::vector< std::size_t > first( nb_rows + 1, 0 ); // crossings of each row
+    for ( const auto& c : crossings ) first[ c.row / e.nx + 1 ]++;
+    for ( std::size_t r = 0; r < nb_rows; r++ ) first[ r + 1 ] += first[ r ];
+    enum : unsigned char { UNKNOWN, EMPTY, FILLED };
+    std::vector< unsigned char > state( nb_rows, UNKNOWN );
+    pool.parallelFor( 0, nb_rows, [&] ( std::size_t r0, std::size_t r1, std::size_t )
+    {
+      for ( std::size_t r = r0; r < r1 && ! isStopped( stop ); r++ )
+        {
+          unsigned char* row = data + r * e.nx;
+          const RowCrossing* c   = crossings.data() + first[ r ];
+          const RowCrossing* end = crossings.data() + first[ r + 1 ];
+          bool filled = false;
+          if ( c == end )
+            { // The whole row is on one side, given by its marked voxels.
+              if      ( std::find( row, row + e.nx, 255 ) != row + e.nx ) filled = true;
+              else if ( std::find( row, row + e.nx, 1 ) == row + e.nx )   continue;
+            }
+          else
+            filled = ! c->fill_right;
+          state[ r ] = filled ? FILLED : EMPTY;
+          for ( std::size_t x = 0; x < e.nx; x++ )
+            {
+              // Runs between two crossings are filled if one of them
+              // says so (only surfaces touching each other disagree).
+              while ( c != end && c->x < x )
+                {
+                  filled = c->fill_right;
+                  ++c;
+                  if ( c != end && ! c->fill_right ) filled = true;
+                }
+              unsigned char& v = row[ x ];
+              if      ( v == 1 ) v = 0;
+              else if ( v == 0 ) v = filled ? 255 : 0;
+            }
+        }
+    } );
+    // The rows crossed by no surface and with no marked voxel have the
+    // side of their y- and z-neighbor rows.
+    if ( isStopped( stop ) ) return;
+    std::vector< std::size_t > queue;
+    for ( std::size_t r = 0; r < nb_rows; r++ )
+      if ( state[ r ] != UNKNOWN ) queue.push_back( r );
+    for ( std::size_t i = 0; i < queue.size(); i++ )
+      {
+        const std::size_t r = queue[ i ];
+        const unsigned char v = data[ r * e.nx ];
+        details::forNeighborRows( r * e.nx, e, [&] ( std::size_t n )
+        {
+          if ( state[ n / e.nx ] != UNKNOWN ) return;
+          state[ n / e.nx ] = v == 255 ? FILLED : EMPTY;
+          std::fill( data + n, data + n + e.nx, v );
+          queue.push_back( n / e.nx );
+        } );
+      }
+  }
+
+  /// Fills the volume \a data of extent \a e from \a seeds, with
+  /// scanlineFill if \a pool has one thread, frontierFill otherwise.
+  inline void floodFill( unsigned char* data, Extent e,
+                         const std::vector< std::size_t >& seeds, ThreadPool& pool,
+                         const StopFlag* stop = nullptr )
+  {
+    if ( pool.size() == 1 ) scanlineFill( data, e, seeds, stop );
+    else                    frontierFill( data, e, seeds, pool, stop );
+  }
+} // namespace IPCV
@@ -0,0 +1,309 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file HomotopicThinning.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Homotopic thinning of a voxel object, one peel of simple points at
+ * a time. The voxels are stored as bits, 64 per word along x, in a
+ * volume padded by one voxel on each side so that 26-neighborhoods
+ * need no bound checks. Simplicity is read in a table indexed by
+ * neighborhood configurations (like simplicity::tableSimple26_6 of
+ * DGtal), and a configuration is made of the 9 triples of bits
+ * x-1,x,x+1 of the rows around the voxel, extracted with shifts and
+ * masks.
+ *
+ * Only the border voxels are queued: a peel examines the voxels of
+ * the queue, removes the simple ones, and queues for the next peel
+ * the object neighbors of the removed voxels. The total work is thus
+ * proportional to the size of the object, not to peels x volume.
+ *
+ * The parallel step splits the lattice into 8 subfields by the parity
+ * of the coordinates. Two voxels of the same subfield are never
+ * 26-adjacent, so that removing one does not change the simplicity of
+ * the other: the subfields are processed one after the other, the
+ * voxels of a subfield being tested and removed concurrently.
+ *
+ * The ordered thinning removes the simple points in a single pass,
+ * by increasing key (typically the squared distance to the
+ * background), with a bucket queue indexed by the keys: a voxel
+ * queued while the bucket k is processed goes in bucket max(key,k),
+ * so that the buckets are emptied in order and never revisited.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// @return the bit of the neighbor (dx,dy,dz) in the 26-neighborhood
+  /// configurations of DGtal (neighbors in raster order, x fastest,
+  /// without the center).
+  inline unsigned int neighborhoodBit( int dx, int dy, int dz )
+  {
+    const int i = ( dz + 1 ) * 9 + ( dy + 1 ) * 3 + ( dx + 1 );
+    return unsigned( i < 13 ? i : i - 1 );
+  }
+
+  /// Peels the simple points of a voxel object.
+  /// @tparam TTable a bitset indexed by configurations, like the
+  /// boost::dynamic_bitset returned by functions::loadTable.
+  template < typename TTable >
+  class HomotopicThinning
+  {
+  public:
+    typedef TTable        Table;
+    typedef std::uint32_t Configuration;
+
+    /// Builds the object made of the voxels i of a volume of extent \a
+    /// e such that \a inside( i ) is true. \a table, the simplicity table
+    /// of the topology of the object, must outlive the thinning.
+    template < typename Predicate >
+    void init( Predicate inside, Extent e, const Table& table )
+    {
+      my_table  = &table;
+      my_extent = e;
+      my_padded = Extent { e.nx + 2, e.ny + 2, e.nz + 2 };
+      my_words  = ( my_padded.nx + 63 ) / 64;
+      // One spare word, since triple() may read the word after the
+      // one of its last bit.
+      my_bits.assign( my_words * my_padded.ny * my_padded.nz + 1, 0 );
+      my_queued.assign( my_padded.size(), 0 );
+      for ( int dz = -1; dz <= 1; dz++ )
+        for ( int dy = -1; dy <= 1; dy++ )
+          {
+            my_rows[ ( dz + 1 ) * 3 + dy + 1 ]
+              = std::ptrdiff_t( dz ) * std::ptrdiff_t( my_padded.ny ) + dy;
+            for ( int dx = -1; dx <= 1; dx++ )
+              if ( dx != 0 || dy != 0 || dz != 0 )
+                my_offsets[ neighborhoodBit( dx, dy, dz ) ]
+                  = ( std::ptrdiff_t( dz ) * std::ptrdiff_t( my_padded.ny ) + dy )
+                  * std::ptrdiff_t( my_padded.nx ) + dx;
+          }
+      my_size = 0;
+      for ( std::size_t z = 0, i = 0; z < e.nz; z++ )
+        for ( std::size_t y = 0; y < e.ny; y++ )
+          for ( std::size_t x = 0; x < e.nx; x++, i++ )
+            if ( inside( i ) )
+              {
+                const std::size_t p = padded( x, y, z );
+                word( p ) |= Word( 1 ) << ( p % my_padded.nx % 64 );
+                my_size++;
+              }
+      // The border voxels are those with a 6-neighbor outside.
+      const std::size_t axes[ 3 ] = { 1, my_padded.nx, my_padded.nx * my_padded.ny };
+      my_queue.clear();
+      for ( std::size_t z = 0; z < e.nz; z++ )
+        for ( std::size_t y = 0; y < e.ny; y++ )
+          for ( std::size_t x = 0; x < e.nx; x++ )
+            {
+              const std::size_t p = padded( x, y, z );
+              if ( ! isInside( p ) ) continue;
+              for ( auto a : axes )
+                if ( ! isInside( p - a ) || ! isInside( p + a ) )
+                  { my_queued[ p ] = 1; my_queue.push_back( p ); break; }
+            }
+      my_removed.clear();
+    }
+
+    /// Removes one peel of simple points.
+    /// @return the number of removed voxels, 0 when the thinning is over.
+    std::size_t oneStep()
+    {
+      std::vector< std::size_t > next;
+      my_removed.clear();
+      for ( auto p : my_queue ) remove( p, next, my_removed );
+      my_queue.swap( next );
+      my_size -= my_removed.size();
+      return my_removed.size();
+    }
+
+    /// Removes one peel of simple points with the threads of \a pool,
+    /// subfield by subfield. The result may differ from oneStep(),
+    /// which removes the voxels in queue order, but the topology is
+    /// preserved as well.
+    /// @return the number of removed voxels, 0 when the thinning is over.
+    std::size_t oneStep( ThreadPool& pool )
+    {
+      std::vector< std::size_t > subfields[ 8 ];
+      for ( auto p : my_queue ) subfields[ subfield( p ) ].push_back( p );
+      std::vector< std::vector< std::size_t > > next( pool.size() ), removed( pool.size() );
+      for ( const auto& voxels : subfields )
+        pool.parallelFor( 0, voxels.size(), [&] ( std::size_t i0, std::size_t i1, std::size_t t )
+        {
+          for ( std::size_t i = i0; i < i1; i++ ) remove( voxels[ i ], next[ t ], removed[ t ] );
+        } );
+      my_queue.clear();
+      my_removed.clear();
+      for ( std::size_t t = 0; t < pool.size(); t++ )
+        {
+          my_queue.insert( my_queue.end(), next[ t ].begin(), next[ t ].end() );
+          my_removed.insert( my_removed.end(), removed[ t ].begin(), removed[ t ].end() );
+        }
+      my_size -= my_removed.size();
+      return my_removed.size();
+    }
+
+    /// Removes in a single pass the simple points of the object in
+    /// order of increasing \a key( i ), an unsigned integer given for
+    /// each voxel i of the object, like its squared distance to the
+    /// background. A voxel i of configuration c such that \a anchor(
+    /// i, c ) is true when it is examined is never removed. Ties are
+    /// broken in queue order, so that the result is deterministic.
+    /// @return the number of removed voxels.
+    template < typename Key, typename Anchor >
+    std::size_t orderedThinning( Key key, Anchor anchor )
+    {
+      std::vector< std::vector< std::size_t > > buckets;
+      auto push = [&] ( std::size_t p, std::size_t k )
+      {
+        k = std::max( k, std::size_t( key( unpadded( p ) ) ) );
+        if ( k >= buckets.size() ) buckets.resize( k + 1 );
+        buckets[ k ].push_back( p );
+      };
+      for ( auto p : my_queue ) push( p, 0 );
+      my_queue.clear();
+      my_removed.clear();
+      std::vector< std::size_t > next;
+      for ( std::size_t k = 0; k < buckets.size(); k++ )
+        // Bucket k grows while it is processed, and may be reallocated.
+        for ( std::size_t i = 0; i < buckets[ k ].size(); i++ )
+          {
+            const std::size_t p = buckets[ k ][ i ];
+            // Anchors stay marked as queued, hence are never queued again.
+            if ( isInside( p ) && anchor( unpadded( p ), configuration( p ) ) ) continue;
+            remove( p, next, my_removed );
+            for ( auto q : next ) push( q, k );
+            next.clear();
+          }
+      my_size -= my_removed.size();
+      return my_removed.size();
+    }
+
+    /// @return the indices of the voxels removed by the last step.
+    const std::vector< std::size_t >& removed() const { return my_removed; }
+
+    /// @return the number of voxels of the object.
+    std::size_t size() const { return my_size; }
+
+    /// @return 'true' if voxel (x,y,z) is in the object.
+    bool isInside( std::size_t x, std::size_t y, std::size_t z ) const
+    { return isInside( padded( x, y, z ) ); }
+
+  private:
+    typedef std::uint64_t                Word;
+    typedef std::atomic_ref< Word >      AtomicWord;
+
+    std::size_t padded( std::size_t x, std::size_t y, std::size_t z ) const
+    { return ( ( z + 1 ) * my_padded.ny + y + 1 ) * my_padded.nx + x + 1; }
+
+    std::size_t unpadded( std::size_t p ) const
+    {
+      const std::size_t x = p % my_padded.nx - 1;
+      const std::size_t y = ( p / my_padded.nx ) % my_padded.ny - 1;
+      const std::size_t z = p / ( my_padded.nx * my_padded.ny ) - 1;
+      return ( z * my_extent.ny + y ) * my_extent.nx + x;
+    }
+
+    /// @return the subfield (0 to 7) of voxel \a p.
+    std::size_t subfield( std::size_t p ) const
+    {
+      const std::size_t x = p % my_padded.nx;
+      const std::size_t y = ( p / my_padded.nx ) % my_padded.ny;
+      const std::size_t z = p / ( my_padded.nx * my_padded.ny );
+      return ( x & 1 ) | ( ( y & 1 ) << 1 ) | ( ( z & 1 ) << 2 );
+    }
+
+    /// Examines the queued voxel \a p: if it is simple, removes it,
+    /// adds it to \a removed and queues its neighbors in \a next.
+    /// Concurrent calls must be on voxels that are not 26-adjacent.
+    void remove( std::size_t p, std::vector< std::size_t >& next,
+                 std::vector< std::size_t >& removed )
+    {
+      my_queued[ p ] = 0;
+      if ( ! isInside( p ) ) return;
+      const Configuration c = configuration( p );
+      if ( ! ( *my_table )[ c ] ) return;
+      // Voxels of the same word may be removed by other threads.
+      AtomicWord( word( p ) ).fetch_and( ~( Word( 1 ) << ( p % my_padded.nx % 64 ) ),
+                                         std::memory_order_relaxed );
+      removed.push_back( unpadded( p ) );
+      for ( unsigned int k = 0; k < 26; k++ )
+        {
+          const std::size_t q = p + my_offsets[ k ];
+          // Neighbors may be queued by several threads at once.
+          if ( ( c >> k & 1 ) && ! std::atomic_ref< unsigned char >( my_queued[ q ] )
+               .exchange( 1, std::memory_order_relaxed ) )
+            next.push_back( q );
+        }
+    }
+
+    /// @return the index of the word holding the bit of voxel \a p.
+    std::size_t wordIndex( std::size_t p ) const
+    { return p / my_padded.nx * my_words + p % my_padded.nx / 64; }
+
+    /// @return the word holding the bit of voxel \a p.
+    Word& word( std::size_t p ) { return my_bits[ wordIndex( p ) ]; }
+
+    /// @return the bits x..x+2 of the row starting at word \a row.
+    Word triple( std::size_t row, std::size_t x ) const
+    {
+      const Word* w = my_bits.data() + row + x / 64;
+      const std::size_t s = x % 64;
+      Word bits = load( w[ 0 ] ) >> s;
+      if ( s > 61 ) bits |= load( w[ 1 ] ) << ( 64 - s );
+      return bits & 7;
+    }
+
+    static Word load( const Word& w )
+    { return AtomicWord( const_cast< Word& >( w ) ).load( std::memory_order_relaxed ); }
+
+    bool isInside( std::size_t p ) const
+    { return ( load( my_bits[ wordIndex( p ) ] ) >> ( p % my_padded.nx % 64 ) ) & 1; }
+
+    /// @return the configuration of the 26-neighbors of voxel \a p:
+    /// the triples of the 9 rows around p, in raster order, without p.
+    Configuration configuration( std::size_t p ) const
+    {
+      const std::size_t row = p / my_padded.nx, x = p % my_padded.nx - 1;
+      Configuration c = 0;
+      for ( unsigned int k = 0; k < 9; k++ )
+        c |= Configuration( triple( ( row + my_rows[ k ] ) * my_words, x ) ) << ( 3 * k );
+      return ( c & 0x1FFF ) | ( ( c >> 14 ) << 13 );
+    }
+
+    const Table*                  my_table = nullptr;
+    Extent                        my_extent { 0, 0, 0 };
+    Extent                        my_padded { 0, 0, 0 };
+    std::ptrdiff_t                my_offsets[ 26 ]; // of the neighbors, by configuration bit
+    std::ptrdiff_t                my_rows[ 9 ];     // of the rows around a voxel, in rows
+    std::size_t                   my_words = 0;     // per row
+    std::vector< Word >           my_bits;          // 1 inside the object, 0 outside
+    std::vector< unsigned char >  my_queued;        // 1 if in the queue
+    std::vector< std::size_t >    my_queue;         // voxels of the next peel
+    std::vector< std::size_t >    my_removed;
+    std::size_t                   my_size = 0;
+  };
+} // namespace IPCV
@@ -0,0 +1,60 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file ImageGenerations.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Generation numbers of images, the keys of the caches computed from
+ * image values (see ThresholdCache and BlockRanges). An image gets a
+ * new generation when it is created and whenever it is modified in
+ * place. A new image allocated at the address of a freed one thus
+ * never gets the generation of the freed one, and never reuses its
+ * caches.
+ */
+#pragma once
+
+#include <cstdint>
+#include <unordered_map>
+
+namespace IPCV
+{
+  /// The current generations of the images of a program.
+  class ImageGenerations
+  {
+  public:
+    /// No image has this generation.
+    static constexpr std::uint64_t NONE = 0;
+
+    /// Gives a new generation to the image of voxels \a data, to be
+    /// called when it is created or modified.
+    /// @return its new generation.
+    std::uint64_t touch( const void* data ) { return my_generations[ data ] = ++my_last; }
+
+    /// @return the generation of the image of voxels \a data, or NONE
+    /// if it was never touched.
+    std::uint64_t operator()( const void* data ) const
+    {
+      const auto it = my_generations.find( data );
+      return it == my_generations.end() ? NONE : it->second;
+    }
+
+  private:
+    std::unordered_map< const void*, std::uint64_t > my_generations;
+    std::uint64_t                                    my_last = NONE;
+  };
+} // namespace IPCV
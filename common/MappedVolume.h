@@ -0,0 +1,210 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file MappedVolume.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * An uncompressed companion format for .vol files, meant to be memory
+ * mapped. A .mvol file is a header page of 4096 bytes, holding the
+ * text "IPCV-MVOL 1" followed by "X: ", "Y: ", "Z: " lines and a line
+ * ".", padded with zeros, then the nx*ny*nz voxels (unsigned char, x
+ * fastest). Voxels are thus page-aligned, and loading them is a
+ * single copy from the mapped pages instead of a decompression.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <DGtal/base/Common.h>
+
+#include "common/Morphology.h"
+
+namespace IPCV
+{
+  /// Size of the header of a .mvol file.
+  constexpr std::size_t MVOL_HEADER_SIZE = 4096;
+
+  /// @return the .mvol companion of \a filename (same name, extension .mvol).
+  inline std::string mappedCompanion( const std::string& filename )
+  {
+    return std::filesystem::path( filename ).replace_extension( ".mvol" ).string();
+  }
+
+  /// @return 'true' if \a filename has extension .mvol.
+  inline bool isMappedVolumeFile( const std::string& filename )
+  {
+    return std::filesystem::path( filename ).extension() == ".mvol";
+  }
+
+  /// Writes the volume \a data of extent \a e as a .mvol file.
+  /// @return 'true' if everything was written.
+  inline bool saveMappedVolume( const unsigned char* data, Extent e,
+                                const std::string& filename )
+  {
+    std::ostringstream header;
+    header << "IPCV-MVOL 1\n" << "X: " << e.nx << "\n" << "Y: " << e.ny << "\n"
+           << "Z: " << e.nz << "\n" << ".\n";
+    std::string page = header.str();
+    page.resize( MVOL_HEADER_SIZE, '\0' );
+    std::ofstream out( filename, std::ios::binary );
+    out.write( page.data(), page.size() );
+    out.write( reinterpret_cast< const char* >( data ), e.size() );
+    out.close();
+    return ! out.fail();
+  }
+
+  /// A read-only memory mapping of a .mvol file.
+  class MappedVolume
+  {
+  public:
+    MappedVolume() = default;
+    ~MappedVolume() { close(); }
+    MappedVolume( const MappedVolume& ) = delete;
+    MappedVolume& operator=( const MappedVolume& ) = delete;
+
+    /// Maps \a filename. @return 'true' if it is a valid .mvol file.
+    bool open( const std::string& filename )
+    {
+      close();
+      if ( ! map( filename ) ) return false;
+      if ( my_length < MVOL_HEADER_SIZE
+           || std::strncmp( (const char*) my_base, "IPCV-MVOL 1\n", 12 ) != 0 )
+        { close(); return false; }
+      std::istringstream header( std::string( (const char*) my_base + 12,
+                                              MVOL_HEADER_SIZE - 12 ) );
+      std::string key;
+      header >> key >> my_extent.nx >> key >> my_extent.ny >> key >> my_extent.nz;
+      if ( ! header || my_length < MVOL_HEADER_SIZE + my_extent.size() )
+        { close(); return false; }
+      return true;
+    }
+
+    /// Unmaps the file.
+    void close()
+    {
+      if ( my_base == nullptr ) return;
+#ifdef _WIN32
+      UnmapViewOfFile( my_base );
+#else
+      munmap( my_base, my_length );
+#endif
+      my_base   = nullptr;
+      my_length = 0;
+      my_extent = Extent { 0, 0, 0 };
+    }
+
+    bool isValid() const { return my_base != nullptr; }
+    Extent extent() const { return my_extent; }
+
+    /// @return a pointer to the voxels, in the mapped pages.
+    const unsigned char* data() const
+    { return static_cast< const unsigned char* >( my_base ) + MVOL_HEADER_SIZE; }
+
+  private:
+    bool map( const std::string& filename )
+    {
+#ifdef _WIN32
+      HANDLE file = CreateFileA( filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                                 nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+      if ( file == INVALID_HANDLE_VALUE ) return false;
+      LARGE_INTEGER size;
+      GetFileSizeEx( file, &size );
+      HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+      CloseHandle( file );
+      if ( mapping == nullptr ) return false;
+      my_base   = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+      my_length = std::size_t( size.QuadPart );
+      CloseHandle( mapping );
+#else
+      const int fd = ::open( filename.c_str(), O_RDONLY );
+      if ( fd < 0 ) return false;
+      struct stat st;
+      if ( fstat( fd, &st ) != 0 || st.st_size == 0 ) { ::close( fd ); return false; }
+      void* base = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+      ::close( fd );
+      if ( base == MAP_FAILED ) return false;
+      my_base   = base;
+      my_length = std::size_t( st.st_size );
+#endif
+      return my_base != nullptr;
+    }
+
+    void*       my_base   = nullptr;
+    std::size_t my_length = 0;
+    Extent      my_extent { 0, 0, 0 };
+  };
+
+  /// Loads a gray-scale image with the shortcuts \a TShortcuts (like
+  /// Shortcuts<Z3i::KSpace>). A .mvol file, or the .mvol companion of
+  /// a .vol file when it is up to date, is memory mapped and copied in
+  /// one go instead of being decompressed. If \a make_companion is
+  /// true, the companion of a .vol file is written after loading it.
+  template < typename TShortcuts >
+  DGtal::CountedPtr< typename TShortcuts::GrayScaleImage >
+  loadGrayScaleImage( const std::string& filename, bool make_companion )
+  {
+    typedef typename TShortcuts::Domain Domain;
+    typedef typename TShortcuts::Point  Point;
+    namespace fs = std::filesystem;
+    const bool  is_mapped = isMappedVolumeFile( filename );
+    std::string mapped    = is_mapped ? filename : mappedCompanion( filename );
+    std::error_code ec1, ec2;
+    if ( is_mapped
+         || ( fs::exists( mapped, ec1 )
+              && fs::last_write_time( mapped, ec1 ) >= fs::last_write_time( filename, ec2 )
+              && ! ec1 && ! ec2 ) )
+      {
+        MappedVolume volume;
+        if ( volume.open( mapped ) )
+          {
+            const auto e = volume.extent();
+            Domain D( Point::zero, Point( int( e.nx ) - 1, int( e.ny ) - 1, int( e.nz ) - 1 ) );
+            auto image = TShortcuts::makeGrayScaleImage( D );
+            std::copy( volume.data(), volume.data() + e.size(), image->begin() );
+            return image;
+          }
+        DGtal::trace.warning() << "Invalid mapped volume <" << mapped << ">" << std::endl;
+      }
+    auto image = TShortcuts::makeGrayScaleImage( filename );
+    if ( make_companion && ! is_mapped )
+      {
+        bool ok = saveMappedVolume( image->data(), extent( *image ), mapped );
+        DGtal::trace.info() << "Writing <" << mapped << "> " << ( ok ? "ok." : "error." ) << std::endl;
+      }
+    return image;
+  }
+} // namespace IPCV
@@ -0,0 +1,379 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file MarchingCubes.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Parallel marching-cubes of a gray-scale volume, separating the voxels
+ * of value > t from the others. Cubes join 8 voxel centers.
+ *
+ * The volume is cut into slabs of cubes along z, each one processed
+ * by one thread with two planes of edge-to-vertex indices. The
+ * vertices on the plane between two slabs are built by both; when
+ * merging, those of the lower slab are welded to those of the upper
+ * slab with the table of the edges of that plane.
+ *
+ * The table of triangles of the 256 configurations is computed once:
+ * on each face of a cube, the crossed edges are joined around the
+ * inside corners (two inside corners on a diagonal are separated),
+ * which makes the surface consistent between adjacent cubes. The
+ * resulting loops are triangulated as fans.
+ *
+ * Given the active blocks of the volume (see BlockRanges), only the
+ * voxels and cubes of these blocks are visited. The extraction stops
+ * at the next z row if its StopFlag is raised.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/BlockRanges.h"
+#include "common/FlatMesh.h"
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// Triangles of each configuration of a cube. Corner i is at
+  /// ( i & 1, ( i >> 1 ) & 1, i >> 2 ), and bit i of a configuration
+  /// is set when corner i is inside. Edge e joins corner edgeCorners[e]
+  /// to the corner one step further along axis edgeAxis[e].
+  class MarchingCubesTable
+  {
+  public:
+    typedef std::array< std::uint8_t, 3 > Triangle; // three edges
+
+    static const MarchingCubesTable& get()
+    {
+      static const MarchingCubesTable table;
+      return table;
+    }
+
+    /// @return the triangles of configuration \a c, oriented so that
+    /// their normal points outside.
+    const std::vector< Triangle >& triangles( int c ) const { return my_triangles[ c ]; }
+
+    int edgeCorner( int e ) const { return my_edge_corner[ e ]; }
+    int edgeAxis( int e )   const { return my_edge_axis[ e ]; }
+
+  private:
+    MarchingCubesTable()
+    {
+      int id[ 8 ][ 8 ];
+      int n = 0;
+      for ( int a = 0; a < 3; a++ )
+        for ( int c = 0; c < 8; c++ )
+          if ( ! ( c & ( 1 << a ) ) )
+            {
+              my_edge_corner[ n ] = c;
+              my_edge_axis[ n ]   = a;
+              id[ c ][ c | ( 1 << a ) ] = id[ c | ( 1 << a ) ][ c ] = n++;
+            }
+      for ( int c = 0; c < 256; c++ ) build( c, id );
+    }
+
+    /// @return 'true' if edges \a e1 and \a e2 lie on the same face.
+    bool shareFace( int e1, int e2 ) const
+    {
+      for ( int b = 0; b < 3; b++ )
+        if ( b != my_edge_axis[ e1 ] && b != my_edge_axis[ e2 ]
+             && ( ( my_edge_corner[ e1 ] >> b ) & 1 ) == ( ( my_edge_corner[ e2 ] >> b ) & 1 ) )
+          return true;
+      return false;
+    }
+
+    /// Computes the triangles of configuration \a config.
+    void build( int config, int id[ 8 ][ 8 ] )
+    {
+      auto inside = [config] ( int c ) { return ( config >> c ) & 1; };
+      int next[ 12 ];
+      for ( int e = 0; e < 12; e++ ) next[ e ] = -1;
+      for ( int a = 0; a < 3; a++ )
+        for ( int s = 0; s < 2; s++ )
+          { // face of normal s ? +e_a : -e_a, corners in cyclic order.
+            const int u = ( a + 1 ) % 3, v = ( a + 2 ) % 3;
+            const int base = s << a;
+            const int corners[ 4 ] = { base, base | ( 1 << u ),
+                                       base | ( 1 << u ) | ( 1 << v ), base | ( 1 << v ) };
+            for ( int i = 0; i < 4; i++ )
+              if ( inside( corners[ i ] ) && ! inside( corners[ ( i + 1 ) % 4 ] ) )
+                { // joins the edges around the inside corners j..i.
+                  int j = i;
+                  while ( inside( corners[ ( j + 3 ) % 4 ] ) ) j = ( j + 3 ) % 4;
+                  const int e_in  = id[ corners[ ( j + 3 ) % 4 ] ][ corners[ j ] ];
+                  const int e_out = id[ corners[ i ] ][ corners[ ( i + 1 ) % 4 ] ];
+                  // The corners are counterclockwise seen from outside
+                  // iff s == 1: keep the inside on the left.
+                  if ( s == 1 ) next[ e_out ] = e_in; else next[ e_in ] = e_out;
+                }
+          }
+      bool done[ 12 ] = { false };
+      for ( int e = 0; e < 12; e++ )
+        {
+          if ( next[ e ] < 0 || done[ e ] ) continue;
+          std::vector< int > loop;
+          for ( int f = e; ! done[ f ]; f = next[ f ] ) { done[ f ] = true; loop.push_back( f ); }
+          // The loop is counterclockwise around the inside: its fan is
+          // reversed. Its root is chosen so that no diagonal lies on a
+          // face of the cube, where the adjacent cube could use it too.
+          const std::size_t n = loop.size();
+          std::size_t root = 0;
+          for ( std::size_t r = 0; r < n; r++ )
+            {
+              bool ok = true;
+              for ( std::size_t k = 2; k + 1 < n && ok; k++ )
+                ok = ! shareFace( loop[ r ], loop[ ( r + k ) % n ] );
+              if ( ok ) { root = r; break; }
+            }
+          for ( std::size_t k = 1; k + 1 < n; k++ )
+            my_triangles[ config ].push_back
+              ( Triangle { std::uint8_t( loop[ root ] ),
+                           std::uint8_t( loop[ ( root + k + 1 ) % n ] ),
+                           std::uint8_t( loop[ ( root + k ) % n ] ) } );
+        }
+    }
+
+    std::vector< Triangle > my_triangles[ 256 ];
+    int my_edge_corner[ 12 ];
+    int my_edge_axis[ 12 ];
+  };
+
+  /// Extracts the isosurface of a volume with the threads of a pool.
+  /// @tparam TRealPoint the type of positions and normals, with a
+  /// ( x, y, z ) constructor and operator[].
+  template < typename TRealPoint >
+  class MarchingCubes
+  {
+  public:
+    typedef TRealPoint                 RealPoint;
+    typedef TriangleMesh< RealPoint >  Mesh;
+
+    /// Builds in \a mesh the surface between the voxels of \a data
+    /// (extent \a e, x fastest) of value > \a t and the others, the
+    /// vertices being interpolated at t + 0.5. Voxel (0,0,0) is at \a
+    /// lo. If \a normals is not null, it receives the normalized
+    /// gradients at the vertices, pointing to lower values. If \a
+    /// blocks is not null, it gives the blocks straddling t. If \a
+    /// stop is raised meanwhile, \a mesh and \a normals are left empty.
+    static void extract( const unsigned char* data, Extent e, RealPoint lo, int t,
+                         Mesh& mesh, ThreadPool& pool,
+                         std::vector< RealPoint >* normals = nullptr,
+                         const BlockMask* blocks = nullptr,
+                         const StopFlag* stop = nullptr )
+    {
+      mesh.clear();
+      if ( normals != nullptr ) normals->clear();
+      if ( e.nx < 2 || e.ny < 2 || e.nz < 2 ) return;
+      const std::size_t nb = std::min( pool.size(), e.nz - 1 );
+      std::vector< Slab > slabs( nb );
+      pool.parallelFor( 0, e.nz - 1, [&] ( std::size_t z0, std::size_t z1, std::size_t s )
+                        { slabs[ s ].extract( data, e, lo, t, z0, z1, normals != nullptr,
+                                              blocks, stop ); } );
+      if ( isStopped( stop ) ) return;
+      // Welds the top vertices of each slab to the bottom ones of the next.
+      std::vector< std::size_t > vtx_offsets( nb + 1, 0 ), tri_offsets( nb + 1, 0 );
+      for ( std::size_t s = 0; s < nb; s++ )
+        {
+          const bool welded = s + 1 < nb;
+          slabs[ s ].kept = welded ? slabs[ s ].top_begin : slabs[ s ].positions.size();
+          vtx_offsets[ s + 1 ] = vtx_offsets[ s ] + slabs[ s ].kept;
+          tri_offsets[ s + 1 ] = tri_offsets[ s ] + slabs[ s ].faces.size();
+        }
+      mesh.positions.resize( vtx_offsets[ nb ] );
+      mesh.faces.resize( tri_offsets[ nb ] );
+      if ( normals != nullptr ) normals->resize( vtx_offsets[ nb ] );
+      pool.parallelFor( 0, nb, [&] ( std::size_t s0, std::size_t s1, std::size_t )
+      {
+        for ( std::size_t s = s0; s < s1; s++ )
+          {
+            Slab& S = slabs[ s ];
+            std::vector< std::uint32_t > remap( S.positions.size() );
+            for ( std::size_t i = 0; i < S.kept; i++ )
+              remap[ i ] = std::uint32_t( vtx_offsets[ s ] + i );
+            if ( S.kept < S.positions.size() )
+              for ( std::size_t k = 0; k < S.top.size(); k++ )
+                if ( S.top[ k ] != NONE )
+                  remap[ S.top[ k ] ] =
+                    std::uint32_t( vtx_offsets[ s + 1 ] + slabs[ s + 1 ].bottom[ k ] );
+            std::copy( S.positions.begin(), S.positions.begin() + S.kept,
+                       mesh.positions.begin() + vtx_offsets[ s ] );
+            if ( normals != nullptr )
+              std::copy( S.normals.begin(), S.normals.begin() + S.kept,
+                         normals->begin() + vtx_offsets[ s ] );
+            for ( std::size_t f = 0; f < S.faces.size(); f++ )
+              for ( int i = 0; i < 3; i++ )
+                mesh.faces[ tri_offsets[ s ] + f ][ i ] = remap[ S.faces[ f ][ i ] ];
+          }
+      } );
+    }
+
+  private:
+    static constexpr std::uint32_t NONE = std::uint32_t( -1 );
+
+    /// The part of the surface in the cubes of z in [z0,z1).
+    struct Slab
+    {
+      std::vector< RealPoint >                       positions;
+      std::vector< RealPoint >                       normals;
+      std::vector< std::array< std::uint32_t, 3 > > faces;
+      std::vector< std::uint32_t > bottom;  // vertices of the x/y-edges of plane z0
+      std::vector< std::uint32_t > top;     // vertices of the x/y-edges of plane z1
+      std::size_t                  top_begin = 0; // the vertices of top are the last ones
+      std::size_t                  kept      = 0; // after welding
+
+      void extract( const unsigned char* data, Extent e, RealPoint lo, int t,
+                    std::size_t z0, std::size_t z1, bool with_normals,
+                    const BlockMask* blocks, const StopFlag* stop )
+      {
+        my_data = data; my_e = e; my_lo = lo; my_iso = t + 0.5; my_normals = with_normals;
+        my_blocks = blocks;
+        const std::size_t nxy = e.nx * e.ny;
+        const unsigned char T = (unsigned char) std::min( std::max( t, -1 ), 255 );
+        std::vector< std::uint32_t > cur( 2 * nxy ), nxt( 2 * nxy ), zedges( nxy );
+        fillPlane( cur, z0, t );
+        bottom = cur;
+        const auto& table = MarchingCubesTable::get();
+        std::uint32_t v[ 12 ];
+        for ( std::size_t z = z0; z < z1 && ! isStopped( stop ); z++ )
+          {
+            fillZEdges( zedges, z, t );
+            if ( z + 1 == z1 ) top_begin = positions.size();
+            fillPlane( nxt, z + 1, t );
+            const unsigned char* p0 = data + z * nxy;
+            const unsigned char* p1 = p0 + nxy;
+            for ( std::size_t y = 0; y + 1 < e.ny; y++ )
+              for ( std::size_t x = nextActive( my_blocks, 0, y, z, e.nx - 1 ); x + 1 < e.nx;
+                    x = nextActive( my_blocks, x + 1, y, z, e.nx - 1 ) )
+                {
+                  const std::size_t k = y * e.nx + x;
+                  int config = 0;
+                  if ( t < 0 ) config = 255;
+                  else if ( t < 255 )
+                    config = int( p0[ k ] > T ) | int( p0[ k + 1 ] > T ) << 1
+                      | int( p0[ k + e.nx ] > T ) << 2 | int( p0[ k + e.nx + 1 ] > T ) << 3
+                      | int( p1[ k ] > T ) << 4 | int( p1[ k + 1 ] > T ) << 5
+                      | int( p1[ k + e.nx ] > T ) << 6 | int( p1[ k + e.nx + 1 ] > T ) << 7;
+                  const auto& tris = table.triangles( config );
+                  if ( tris.empty() ) continue;
+                  for ( int ed = 0; ed < 12; ed++ )
+                    {
+                      const int c = table.edgeCorner( ed );
+                      const int a = table.edgeAxis( ed );
+                      const std::size_t q = ( y + ( ( c >> 1 ) & 1 ) ) * e.nx + x + ( c & 1 );
+                      v[ ed ] = ( a == 2 ) ? zedges[ q ]
+                        : ( ( c >> 2 ) ? nxt : cur )[ 2 * q + a ];
+                    }
+                  for ( const auto& tri : tris )
+                    faces.push_back( { v[ tri[ 0 ] ], v[ tri[ 1 ] ], v[ tri[ 2 ] ] } );
+                }
+            std::swap( cur, nxt );
+          }
+        top = cur;
+      }
+
+    private:
+      unsigned char value( std::size_t x, std::size_t y, std::size_t z ) const
+      { return my_data[ ( z * my_e.ny + y ) * my_e.nx + x ]; }
+
+      /// @return the vertex on the edge from voxel (x,y,z) along axis \a a.
+      std::uint32_t addVertex( std::size_t x, std::size_t y, std::size_t z, int a )
+      {
+        std::size_t q[ 3 ] = { x, y, z };
+        const double v0 = value( x, y, z );
+        q[ a ]++;
+        const double v1 = value( q[ 0 ], q[ 1 ], q[ 2 ] );
+        const double l  = ( my_iso - v0 ) / ( v1 - v0 );
+        double p[ 3 ] = { double( x ), double( y ), double( z ) };
+        p[ a ] += l;
+        positions.push_back( RealPoint( my_lo[ 0 ] + p[ 0 ], my_lo[ 1 ] + p[ 1 ],
+                                        my_lo[ 2 ] + p[ 2 ] ) );
+        if ( my_normals )
+          {
+            double g0[ 3 ], g1[ 3 ];
+            gradient( x, y, z, g0 );
+            gradient( q[ 0 ], q[ 1 ], q[ 2 ], g1 );
+            double n[ 3 ], norm = 0.0;
+            for ( int i = 0; i < 3; i++ )
+              { n[ i ] = -( ( 1.0 - l ) * g0[ i ] + l * g1[ i ] ); norm += n[ i ] * n[ i ]; }
+            norm = norm > 0.0 ? 1.0 / std::sqrt( norm ) : 0.0;
+            normals.push_back( RealPoint( n[ 0 ] * norm, n[ 1 ] * norm, n[ 2 ] * norm ) );
+          }
+        return std::uint32_t( positions.size() - 1 );
+      }
+
+      /// Central differences, one-sided on the border.
+      void gradient( std::size_t x, std::size_t y, std::size_t z, double g[ 3 ] ) const
+      {
+        const std::size_t p[ 3 ] = { x, y, z };
+        const std::size_t n[ 3 ] = { my_e.nx, my_e.ny, my_e.nz };
+        for ( int a = 0; a < 3; a++ )
+          {
+            std::size_t lo[ 3 ] = { x, y, z }, hi[ 3 ] = { x, y, z };
+            if ( p[ a ] > 0 ) lo[ a ]--;
+            if ( p[ a ] + 1 < n[ a ] ) hi[ a ]++;
+            g[ a ] = ( double( value( hi[ 0 ], hi[ 1 ], hi[ 2 ] ) )
+                       - double( value( lo[ 0 ], lo[ 1 ], lo[ 2 ] ) ) )
+              / double( std::max( std::size_t( 1 ), hi[ a ] - lo[ a ] ) );
+          }
+      }
+
+      bool crossed( unsigned char v0, unsigned char v1, int t ) const
+      { return ( int( v0 ) > t ) != ( int( v1 ) > t ); }
+
+      /// Builds the vertices of the crossed x- and y-edges of plane z.
+      void fillPlane( std::vector< std::uint32_t >& plane, std::size_t z, int t )
+      {
+        if ( my_blocks != nullptr ) std::fill( plane.begin(), plane.end(), NONE );
+        for ( std::size_t y = 0; y < my_e.ny; y++ )
+          for ( std::size_t x = nextActive( my_blocks, 0, y, z, my_e.nx ); x < my_e.nx;
+                x = nextActive( my_blocks, x + 1, y, z, my_e.nx ) )
+            {
+              const std::size_t k = y * my_e.nx + x;
+              const unsigned char v = value( x, y, z );
+              plane[ 2 * k ] = ( x + 1 < my_e.nx && crossed( v, value( x + 1, y, z ), t ) )
+                ? addVertex( x, y, z, 0 ) : NONE;
+              plane[ 2 * k + 1 ] = ( y + 1 < my_e.ny && crossed( v, value( x, y + 1, z ), t ) )
+                ? addVertex( x, y, z, 1 ) : NONE;
+            }
+      }
+
+      /// Builds the vertices of the crossed z-edges from plane z.
+      void fillZEdges( std::vector< std::uint32_t >& edges, std::size_t z, int t )
+      {
+        if ( my_blocks != nullptr ) std::fill( edges.begin(), edges.end(), NONE );
+        for ( std::size_t y = 0; y < my_e.ny; y++ )
+          for ( std::size_t x = nextActive( my_blocks, 0, y, z, my_e.nx ); x < my_e.nx;
+                x = nextActive( my_blocks, x + 1, y, z, my_e.nx ) )
+            edges[ y * my_e.nx + x ] = crossed( value( x, y, z ), value( x, y, z + 1 ), t )
+              ? addVertex( x, y, z, 2 ) : NONE;
+      }
+
+      const unsigned char* my_data = nullptr;
+      Extent               my_e { 0, 0, 0 };
+      RealPoint            my_lo;
+      double               my_iso = 0.0;
+      bool                 my_normals = false;
+      const BlockMask*     my_blocks  = nullptr;
+    };
+  };
+} // namespace IPCV
@@ -0,0 +1,368 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file Morphology.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Separable gray-level morphology on 3d images of unsigned char, with
+ * cubic structuring elements of radius r, i.e. (2r+1)^3 voxels.
+ *
+ * Each axis is processed with the van Herk / Gil-Werman algorithm,
+ * whose cost is about 3 min/max per voxel whatever the radius. Along
+ * y and z, a "sample" of the 1d filter is a whole row of x-values, so
+ * that min/max are computed on contiguous memory with the vectorized
+ * kernels of RowKernels.h.
+ *
+ * The x- and y-passes work on independent z-slices and the z-pass on
+ * independent xz-planes, so the parallel versions split the volume
+ * into slabs along z (resp. y) and need no halo: their output is
+ * identical to the sequential one.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <cstddef>
+#include <vector>
+
+#include "common/RowKernels.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// Max operator, used by dilations.
+  struct MaxOp {
+    static constexpr unsigned char neutral = 0;
+    static unsigned char apply( unsigned char a, unsigned char b )
+    { return a < b ? b : a; }
+    static void applyRow( unsigned char* dst, const unsigned char* a,
+                          const unsigned char* b, std::size_t len )
+    { rowMax( dst, a, b, len ); }
+  };
+
+  /// Min operator, used by erosions.
+  struct MinOp {
+    static constexpr unsigned char neutral = 255;
+    static unsigned char apply( unsigned char a, unsigned char b )
+    { return a < b ? a : b; }
+    static void applyRow( unsigned char* dst, const unsigned char* a,
+                          const unsigned char* b, std::size_t len )
+    { rowMin( dst, a, b, len ); }
+  };
+
+  /// The size of a 3d image stored contiguously, x being the fastest
+  /// axis, then y, then z (as ImageContainerBySTLVector).
+  struct Extent {
+    std::size_t nx, ny, nz;
+    std::size_t size() const { return nx * ny * nz; }
+  };
+
+  /// Scratch memory for the 1d filters (the prefix/suffix arrays of
+  /// van Herk / Gil-Werman, and one row of neutral values).
+  struct LineBuffers {
+    std::vector< unsigned char > g;
+    std::vector< unsigned char > h;
+    std::vector< unsigned char > neutral;
+    void reserve( std::size_t n, std::size_t len, int radius )
+    {
+      const std::size_t L = ( n + 2 * radius ) * len;
+      if ( g.size() < L ) { g.resize( L ); h.resize( L ); }
+      if ( neutral.size() < len ) neutral.resize( len );
+    }
+  };
+
+  namespace details
+  {
+    /// dst[ k ] = Op( a[ k ], b[ k ] ) for k in [0,len)
+    template < typename Op >
+    inline void rowApply( unsigned char* dst, const unsigned char* a,
+                          const unsigned char* b, std::size_t len )
+    {
+      Op::applyRow( dst, a, b, len );
+    }
+
+    /// Filters in place one line of \a n samples, where sample i
+    /// starts at data + i * stride and is made of \a len contiguous
+    /// values. Each output sample is the Op of the samples in
+    /// [i-r,i+r], restricted to the line.
+    template < typename Op >
+    void filterLine( unsigned char* data, std::size_t n,
+                     std::size_t stride, std::size_t len, int r,
+                     LineBuffers& buffers )
+    {
+      if ( r <= 0 || n == 0 ) return;
+      buffers.reserve( n, len, r );
+      std::fill( buffers.neutral.begin(), buffers.neutral.begin() + len,
+                 Op::neutral );
+      // The line is virtually padded with r neutral samples on each side.
+      const std::size_t w = 2 * r + 1;
+      const std::size_t L = n + 2 * r;
+      unsigned char* g = buffers.g.data();
+      unsigned char* h = buffers.h.data();
+      auto sample = [&] ( std::size_t q ) -> const unsigned char*
+      {
+        return ( q < std::size_t( r ) || q >= n + r )
+          ? buffers.neutral.data()
+          : data + ( q - r ) * stride;
+      };
+      // g: Op from the beginning of each block of size w.
+      for ( std::size_t q = 0; q < L; q++ )
+        if ( q % w == 0 ) std::memcpy( g + q * len, sample( q ), len );
+        else rowApply< Op >( g + q * len, g + ( q - 1 ) * len, sample( q ), len );
+      // h: Op up to the end of each block of size w.
+      for ( std::size_t q = L; q-- > 0; )
+        if ( q == L - 1 || ( q + 1 ) % w == 0 )
+          std::memcpy( h + q * len, sample( q ), len );
+        else rowApply< Op >( h + q * len, h + ( q + 1 ) * len, sample( q ), len );
+      // The window [i,i+w-1] (padded coordinates) covers at most two blocks.
+      for ( std::size_t i = 0; i < n; i++ )
+        rowApply< Op >( data + i * stride, h + i * len, g + ( i + w - 1 ) * len, len );
+    }
+
+    /// Specialization of filterLine for one contiguous line of values.
+    template < typename Op >
+    void filterRow( unsigned char* data, std::size_t n, int r,
+                    LineBuffers& buffers )
+    {
+      if ( r <= 0 || n == 0 ) return;
+      buffers.reserve( n, 1, r );
+      const std::size_t w = 2 * r + 1;
+      const std::size_t L = n + 2 * r;
+      unsigned char* g = buffers.g.data();
+      unsigned char* h = buffers.h.data();
+      auto sample = [&] ( std::size_t q ) -> unsigned char
+      {
+        return ( q < std::size_t( r ) || q >= n + r ) ? Op::neutral : data[ q - r ];
+      };
+      for ( std::size_t q = 0; q < L; q++ )
+        g[ q ] = ( q % w == 0 ) ? sample( q ) : Op::apply( g[ q - 1 ], sample( q ) );
+      for ( std::size_t q = L; q-- > 0; )
+        h[ q ] = ( q == L - 1 || ( q + 1 ) % w == 0 )
+          ? sample( q ) : Op::apply( h[ q + 1 ], sample( q ) );
+      rowApply< Op >( data, h, g + w - 1, n );
+    }
+  } // namespace details
+
+  /// Filters in place the rows of z-slices [z0,z1) along the x-axis.
+  template < typename Op >
+  void filterAxisX( unsigned char* data, Extent e, int r,
+                    std::size_t z0, std::size_t z1, LineBuffers& buffers )
+  {
+    for ( std::size_t z = z0; z < z1; z++ )
+      for ( std::size_t y = 0; y < e.ny; y++ )
+        details::filterRow< Op >( data + ( z * e.ny + y ) * e.nx, e.nx, r, buffers );
+  }
+
+  /// Filters in place the z-slices [z0,z1) along the y-axis.
+  template < typename Op >
+  void filterAxisY( unsigned char* data, Extent e, int r,
+                    std::size_t z0, std::size_t z1, LineBuffers& buffers )
+  {
+    for ( std::size_t z = z0; z < z1; z++ )
+      details::filterLine< Op >( data + z * e.ny * e.nx, e.ny, e.nx, e.nx,
+                                 r, buffers );
+  }
+
+  /// Filters in place the xz-planes [y0,y1) along the z-axis.
+  template < typename Op >
+  void filterAxisZ( unsigned char* data, Extent e, int r,
+                    std::size_t y0, std::size_t y1, LineBuffers& buffers )
+  {
+    for ( std::size_t y = y0; y < y1; y++ )
+      details::filterLine< Op >( data + y * e.nx, e.nz, e.nx * e.ny, e.nx,
+                                 r, buffers );
+  }
+
+  /// Filters in place the whole volume with a cube of radius \a r.
+  template < typename Op >
+  void filterBox( unsigned char* data, Extent e, int r )
+  {
+    LineBuffers buffers;
+    filterAxisX< Op >( data, e, r, 0, e.nz, buffers );
+    filterAxisY< Op >( data, e, r, 0, e.nz, buffers );
+    filterAxisZ< Op >( data, e, r, 0, e.ny, buffers );
+  }
+
+  /// Filters in place the whole volume with a cube of radius \a r,
+  /// slabs being processed in parallel by the threads of \a pool.
+  /// Thread t uses \a buffers[ t ] as scratch memory, so nothing is
+  /// allocated if they are already big enough. If \a stop is raised,
+  /// the filter stops at the next slice: the volume is then only
+  /// partially filtered, each voxel still depending only on the
+  /// voxels within distance r.
+  template < typename Op >
+  void filterBox( unsigned char* data, Extent e, int r, ThreadPool& pool,
+                  std::vector< LineBuffers >& buffers, const StopFlag* stop = nullptr )
+  {
+    if ( r <= 0 ) return;
+    if ( buffers.size() < pool.size() ) buffers.resize( pool.size() );
+    pool.parallelFor( 0, e.nz, [&] ( std::size_t z0, std::size_t z1, std::size_t t )
+    {
+      for ( std::size_t z = z0; z < z1 && ! isStopped( stop ); z++ )
+        {
+          filterAxisX< Op >( data, e, r, z, z + 1, buffers[ t ] );
+          filterAxisY< Op >( data, e, r, z, z + 1, buffers[ t ] );
+        }
+    } );
+    pool.parallelFor( 0, e.ny, [&] ( std::size_t y0, std::size_t y1, std::size_t t )
+    {
+      for ( std::size_t y = y0; y < y1 && ! isStopped( stop ); y++ )
+        filterAxisZ< Op >( data, e, r, y, y + 1, buffers[ t ] );
+    } );
+  }
+
+  /// Filters in place the whole volume with a cube of radius \a r,
+  /// slabs being processed in parallel by the threads of \a pool.
+  template < typename Op >
+  void filterBox( unsigned char* data, Extent e, int r, ThreadPool& pool )
+  {
+    std::vector< LineBuffers > buffers;
+    filterBox< Op >( data, e, r, pool, buffers );
+  }
+
+  /// @return the extent of an image stored as ImageContainerBySTLVector.
+  template < typename TImage >
+  Extent extent( const TImage& image )
+  {
+    const auto d = image.domain().upperBound() - image.domain().lowerBound();
+    return Extent { std::size_t( d[ 0 ] + 1 ), std::size_t( d[ 1 ] + 1 ),
+                    std::size_t( d[ 2 ] + 1 ) };
+  }
+
+  /// Dilates in place a gray-scale image with a cube of radius \a r.
+  /// @param image any image of unsigned char stored contiguously (like SH3::GrayScaleImage).
+  /// @param r the radius of the structuring element (0 does nothing).
+  template < typename TImage >
+  void dilate( TImage& image, int r )
+  {
+    filterBox< MaxOp >( image.data(), extent( image ), r );
+  }
+
+  /// Erodes in place a gray-scale image with a cube of radius \a r.
+  /// @param image any image of unsigned char stored contiguously (like SH3::GrayScaleImage).
+  /// @param r the radius of the structuring element (0 does nothing).
+  template < typename TImage >
+  void erode( TImage& image, int r )
+  {
+    filterBox< MinOp >( image.data(), extent( image ), r );
+  }
+
+  /// Closes in place a gray-scale image (dilation then erosion) with
+  /// a cube of radius \a r.
+  template < typename TImage >
+  void close( TImage& image, int r )
+  {
+    dilate( image, r );
+    erode( image, r );
+  }
+
+  /// Parallel version of dilate, with the threads of \a pool.
+  template < typename TImage >
+  void dilate( TImage& image, int r, ThreadPool& pool )
+  {
+    filterBox< MaxOp >( image.data(), extent( image ), r, pool );
+  }
+
+  /// Parallel version of erode, with the threads of \a pool.
+  template < typename TImage >
+  void erode( TImage& image, int r, ThreadPool& pool )
+  {
+    filterBox< MinOp >( image.data(), extent( image ), r, pool );
+  }
+
+  /// Parallel version of close, with the threads of \a pool.
+  template < typename TImage >
+  void close( TImage& image, int r, ThreadPool& pool )
+  {
+    dilate( image, r, pool );
+    erode( image, r, pool );
+  }
+
+  /// Applies morphological operations in place on images of a given
+  /// extent. All the scratch memory is allocated by setup, so that a
+  /// sequence of dilations and erosions allocates nothing and never
+  /// clones the image.
+  class MorphologyEngine
+  {
+  public:
+    /// The engine uses the threads of \a pool, which must outlive it.
+    explicit MorphologyEngine( ThreadPool& pool ) : my_pool( &pool ) {}
+
+    /// Allocates scratch memory for images of extent \a e and radii
+    /// up to \a max_radius (larger radii still work, but allocate).
+    void setup( Extent e, int max_radius )
+    {
+      my_buffers.resize( my_pool->size() );
+      for ( auto& b : my_buffers )
+        {
+          b.reserve( e.nx, 1, max_radius );
+          b.reserve( std::max( e.ny, e.nz ), e.nx, max_radius );
+        }
+    }
+
+    /// Dilates in place the volume \a data of extent \a e with a cube
+    /// of radius \a r. If \a stop is raised meanwhile, the volume is
+    /// left partially filtered (see filterBox).
+    void dilate( unsigned char* data, Extent e, int r, const StopFlag* stop = nullptr )
+    {
+      filterBox< MaxOp >( data, e, r, *my_pool, my_buffers, stop );
+    }
+
+    /// Erodes in place the volume \a data of extent \a e with a cube
+    /// of radius \a r. If \a stop is raised meanwhile, the volume is
+    /// left partially filtered (see filterBox).
+    void erode( unsigned char* data, Extent e, int r, const StopFlag* stop = nullptr )
+    {
+      filterBox< MinOp >( data, e, r, *my_pool, my_buffers, stop );
+    }
+
+    /// Closes in place the volume \a data of extent \a e with a cube
+    /// of radius \a r. If \a stop is raised meanwhile, the volume is
+    /// left partially filtered (see filterBox).
+    void close( unsigned char* data, Extent e, int r, const StopFlag* stop = nullptr )
+    {
+      dilate( data, e, r, stop );
+      erode( data, e, r, stop );
+    }
+
+    /// Dilates in place \a image with a cube of radius \a r.
+    template < typename TImage >
+    void dilate( TImage& image, int r, const StopFlag* stop = nullptr )
+    {
+      dilate( image.data(), extent( image ), r, stop );
+    }
+
+    /// Erodes in place \a image with a cube of radius \a r.
+    template < typename TImage >
+    void erode( TImage& image, int r, const StopFlag* stop = nullptr )
+    {
+      erode( image.data(), extent( image ), r, stop );
+    }
+
+    /// Closes in place \a image with a cube of radius \a r.
+    template < typename TImage >
+    void close( TImage& image, int r, const StopFlag* stop = nullptr )
+    {
+      close( image.data(), extent( image ), r, stop );
+    }
+
+  private:
+    ThreadPool*                my_pool;
+    std::vector< LineBuffers > my_buffers;
+  };
+} // namespace IPCV
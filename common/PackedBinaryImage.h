@@ -0,0 +1,141 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file PackedBinaryImage.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * A binary image storing 64 voxels per word, filled by thresholding a
+ * gray-scale image with the vectorized kernel packGreater.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/Morphology.h"
+#include "common/RowKernels.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// A binary image whose voxels are bits of 64-bit words, in the
+  /// order of ImageContainerBySTLVector (x fastest). It is a model of
+  /// DGtal point predicate, hence may be given directly to
+  /// SH3::makeDigitalSurface.
+  /// @tparam TDomain a DGtal 3d domain type, like Z3i::Domain.
+  template < typename TDomain >
+  class PackedBinaryImage
+  {
+  public:
+    typedef TDomain                Domain;
+    typedef typename Domain::Point Point;
+    typedef bool                   Value;
+
+    /// An image of domain \a domain, all voxels being false.
+    explicit PackedBinaryImage( const Domain& domain )
+      : my_domain( domain )
+    {
+      const auto d = domain.upperBound() - domain.lowerBound();
+      my_extent = Extent { std::size_t( d[ 0 ] + 1 ), std::size_t( d[ 1 ] + 1 ),
+                           std::size_t( d[ 2 ] + 1 ) };
+      my_words.assign( ( my_extent.size() + 63 ) / 64, 0 );
+    }
+
+    const Domain& domain() const { return my_domain; }
+    Extent extent() const { return my_extent; }
+
+    /// @return the value at point \a p of the domain.
+    bool operator()( const Point& p ) const
+    {
+      const std::size_t k = index( p );
+      return ( my_words[ k >> 6 ] >> ( k & 63 ) ) & 1;
+    }
+
+    /// Sets the value at point \a p of the domain to \a v.
+    void setValue( const Point& p, bool v )
+    {
+      const std::size_t   k    = index( p );
+      const std::uint64_t mask = std::uint64_t( 1 ) << ( k & 63 );
+      if ( v ) my_words[ k >> 6 ] |= mask; else my_words[ k >> 6 ] &= ~mask;
+    }
+
+    /// @return the number of true voxels.
+    std::size_t count() const
+    {
+      std::size_t n = 0;
+      for ( auto w : my_words ) n += __builtin_popcountll( w );
+      return n;
+    }
+
+    std::uint64_t*       words()       { return my_words.data(); }
+    const std::uint64_t* words() const { return my_words.data(); }
+    std::size_t nbWords() const { return my_words.size(); }
+
+    /// Sets each voxel to data[ k ] > t, where \a data holds the
+    /// extent().size() values of a gray-scale image of the same domain.
+    void threshold( const unsigned char* data, int t )
+    {
+      thresholdWords( data, t, 0, my_words.size() );
+    }
+
+    /// Parallel version of threshold, with the threads of \a pool.
+    void threshold( const unsigned char* data, int t, ThreadPool& pool )
+    {
+      pool.parallelFor( 0, my_words.size(),
+                        [&] ( std::size_t w0, std::size_t w1, std::size_t )
+                        { thresholdWords( data, t, w0, w1 ); } );
+    }
+
+  private:
+    std::size_t index( const Point& p ) const
+    {
+      const Point q = p - my_domain.lowerBound();
+      return ( std::size_t( q[ 2 ] ) * my_extent.ny + std::size_t( q[ 1 ] ) )
+        * my_extent.nx + std::size_t( q[ 0 ] );
+    }
+
+    /// Thresholds the voxels of words [w0,w1).
+    void thresholdWords( const unsigned char* data, int t, std::size_t w0, std::size_t w1 )
+    {
+      if ( t < 0 || t >= 255 )
+        { // every value is above, or none is.
+          std::fill( my_words.begin() + w0, my_words.begin() + w1,
+                     t < 0 ? ~std::uint64_t( 0 ) : std::uint64_t( 0 ) );
+          if ( t < 0 && w1 == my_words.size() && my_extent.size() % 64 != 0 )
+            my_words.back() &= ( std::uint64_t( 1 ) << ( my_extent.size() % 64 ) ) - 1;
+          return;
+        }
+      const std::size_t full = std::min( w1, my_extent.size() / 64 );
+      if ( w0 < full )
+        packGreater( my_words.data() + w0, data + 64 * w0, full - w0, (unsigned char) t );
+      for ( std::size_t w = std::max( w0, full ); w < w1; w++ )
+        { // last, incomplete, word.
+          std::uint64_t bits = 0;
+          for ( std::size_t k = 64 * w; k < my_extent.size(); k++ )
+            bits |= std::uint64_t( data[ k ] > t ) << ( k - 64 * w );
+          my_words[ w ] = bits;
+        }
+    }
+
+    Domain                       my_domain;
+    Extent                       my_extent;
+    std::vector< std::uint64_t > my_words;
+  };
+} // namespace IPCV
@@ -0,0 +1,260 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file RowKernels.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Vectorized kernels working on rows of unsigned char (max, min,
+ * thresholding into packed bits and conversion to double). With gcc or
+ * clang on x86, the best of AVX-512BW, AVX2 and SSE2 is chosen at run
+ * time according to the CPU; elsewhere the scalar versions are used.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if ( defined(__GNUC__) || defined(__clang__) ) && ( defined(__x86_64__) || defined(__i386__) )
+#define IPCV_X86_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+namespace IPCV
+{
+  namespace kernels
+  {
+    /// A kernel computing dst[ k ] = op( a[ k ], b[ k ] ) for k in [0,len).
+    typedef void (*RowFunction)( unsigned char* dst, const unsigned char* a,
+                                 const unsigned char* b, std::size_t len );
+
+    inline void rowMaxScalar( unsigned char* dst, const unsigned char* a,
+                              const unsigned char* b, std::size_t len )
+    {
+      for ( std::size_t k = 0; k < len; k++ )
+        dst[ k ] = a[ k ] < b[ k ] ? b[ k ] : a[ k ];
+    }
+
+    inline void rowMinScalar( unsigned char* dst, const unsigned char* a,
+                              const unsigned char* b, std::size_t len )
+    {
+      for ( std::size_t k = 0; k < len; k++ )
+        dst[ k ] = a[ k ] < b[ k ] ? a[ k ] : b[ k ];
+    }
+
+    /// A kernel setting bit j of dst[ w ] to src[ 64*w + j ] > t, for w in [0,nb).
+    typedef void (*PackFunction)( std::uint64_t* dst, const unsigned char* src,
+                                  std::size_t nb, unsigned char t );
+
+    inline void packGreaterScalar( std::uint64_t* dst, const unsigned char* src,
+                                   std::size_t nb, unsigned char t )
+    {
+      for ( std::size_t w = 0; w < nb; w++, src += 64 )
+        {
+          std::uint64_t bits = 0;
+          for ( unsigned int j = 0; j < 64; j++ )
+            bits |= std::uint64_t( src[ j ] > t ) << j;
+          dst[ w ] = bits;
+        }
+    }
+
+    /// A kernel computing dst[ k ] = double( src[ k ] ) for k in [0,len).
+    typedef void (*ConvertFunction)( double* dst, const unsigned char* src, std::size_t len );
+
+    inline void toDoubleScalar( double* dst, const unsigned char* src, std::size_t len )
+    {
+      for ( std::size_t k = 0; k < len; k++ ) dst[ k ] = src[ k ];
+    }
+
+#ifdef IPCV_X86_DISPATCH
+    // vpmaxub / vpminub on 16, 32 or 64 bytes at once.
+#define IPCV_ROW_KERNEL( NAME, TARGET, TYPE, WIDTH, LOAD, STORE, OP, TAIL ) \
+    __attribute__(( target( TARGET ) ))                                 \
+    inline void NAME( unsigned char* dst, const unsigned char* a,       \
+                      const unsigned char* b, std::size_t len )         \
+    {                                                                   \
+      std::size_t k = 0;                                                \
+      for ( ; k + WIDTH <= len; k += WIDTH )                            \
+        STORE( (TYPE*)( dst + k ),                                      \
+               OP( LOAD( (const TYPE*)( a + k ) ),                      \
+                   LOAD( (const TYPE*)( b + k ) ) ) );                  \
+      TAIL( dst + k, a + k, b + k, len - k );                           \
+    }
+
+    IPCV_ROW_KERNEL( rowMaxSSE2, "sse2", __m128i, 16,
+                     _mm_loadu_si128, _mm_storeu_si128, _mm_max_epu8, rowMaxScalar )
+    IPCV_ROW_KERNEL( rowMinSSE2, "sse2", __m128i, 16,
+                     _mm_loadu_si128, _mm_storeu_si128, _mm_min_epu8, rowMinScalar )
+    IPCV_ROW_KERNEL( rowMaxAVX2, "avx2", __m256i, 32,
+                     _mm256_loadu_si256, _mm256_storeu_si256, _mm256_max_epu8, rowMaxSSE2 )
+    IPCV_ROW_KERNEL( rowMinAVX2, "avx2", __m256i, 32,
+                     _mm256_loadu_si256, _mm256_storeu_si256, _mm256_min_epu8, rowMinSSE2 )
+    IPCV_ROW_KERNEL( rowMaxAVX512, "avx512f,avx512bw", __m512i, 64,
+                     _mm512_loadu_si512, _mm512_storeu_si512, _mm512_max_epu8, rowMaxAVX2 )
+    IPCV_ROW_KERNEL( rowMinAVX512, "avx512f,avx512bw", __m512i, 64,
+                     _mm512_loadu_si512, _mm512_storeu_si512, _mm512_min_epu8, rowMinAVX2 )
+#undef IPCV_ROW_KERNEL
+
+    // Unsigned comparison through a signed one, by flipping the high bit.
+    __attribute__(( target( "sse2" ) ))
+    inline void packGreaterSSE2( std::uint64_t* dst, const unsigned char* src,
+                                 std::size_t nb, unsigned char t )
+    {
+      const __m128i flip = _mm_set1_epi8( char( 0x80 ) );
+      const __m128i tt   = _mm_set1_epi8( char( t ^ 0x80 ) );
+      for ( std::size_t w = 0; w < nb; w++, src += 64 )
+        {
+          std::uint64_t bits = 0;
+          for ( unsigned int j = 0; j < 64; j += 16 )
+            {
+              const __m128i v = _mm_xor_si128( _mm_loadu_si128( (const __m128i*)( src + j ) ), flip );
+              bits |= std::uint64_t( std::uint16_t( _mm_movemask_epi8( _mm_cmpgt_epi8( v, tt ) ) ) ) << j;
+            }
+          dst[ w ] = bits;
+        }
+    }
+
+    __attribute__(( target( "avx2" ) ))
+    inline void packGreaterAVX2( std::uint64_t* dst, const unsigned char* src,
+                                 std::size_t nb, unsigned char t )
+    {
+      const __m256i flip = _mm256_set1_epi8( char( 0x80 ) );
+      const __m256i tt   = _mm256_set1_epi8( char( t ^ 0x80 ) );
+      for ( std::size_t w = 0; w < nb; w++, src += 64 )
+        {
+          const __m256i lo = _mm256_xor_si256( _mm256_loadu_si256( (const __m256i*)( src ) ), flip );
+          const __m256i hi = _mm256_xor_si256( _mm256_loadu_si256( (const __m256i*)( src + 32 ) ), flip );
+          dst[ w ] = std::uint64_t( std::uint32_t( _mm256_movemask_epi8( _mm256_cmpgt_epi8( lo, tt ) ) ) )
+            | ( std::uint64_t( std::uint32_t( _mm256_movemask_epi8( _mm256_cmpgt_epi8( hi, tt ) ) ) ) << 32 );
+        }
+    }
+
+    __attribute__(( target( "avx512f,avx512bw" ) ))
+    inline void packGreaterAVX512( std::uint64_t* dst, const unsigned char* src,
+                                   std::size_t nb, unsigned char t )
+    {
+      const __m512i tt = _mm512_set1_epi8( char( t ) );
+      for ( std::size_t w = 0; w < nb; w++, src += 64 )
+        dst[ w ] = _mm512_cmpgt_epu8_mask( _mm512_loadu_si512( (const void*)( src ) ), tt );
+    }
+
+    // Widening of 16 bytes to 32-bit integers, then to doubles.
+    __attribute__(( target( "sse2" ) ))
+    inline void toDoubleSSE2( double* dst, const unsigned char* src, std::size_t len )
+    {
+      const __m128i zero = _mm_setzero_si128();
+      std::size_t k = 0;
+      for ( ; k + 16 <= len; k += 16 )
+        {
+          const __m128i b  = _mm_loadu_si128( (const __m128i*)( src + k ) );
+          const __m128i lo = _mm_unpacklo_epi8( b, zero );
+          const __m128i hi = _mm_unpackhi_epi8( b, zero );
+          const __m128i w[ 4 ] = { _mm_unpacklo_epi16( lo, zero ), _mm_unpackhi_epi16( lo, zero ),
+                                   _mm_unpacklo_epi16( hi, zero ), _mm_unpackhi_epi16( hi, zero ) };
+          for ( int q = 0; q < 4; q++ )
+            {
+              _mm_storeu_pd( dst + k + 4 * q,     _mm_cvtepi32_pd( w[ q ] ) );
+              _mm_storeu_pd( dst + k + 4 * q + 2, _mm_cvtepi32_pd( _mm_srli_si128( w[ q ], 8 ) ) );
+            }
+        }
+      toDoubleScalar( dst + k, src + k, len - k );
+    }
+
+    __attribute__(( target( "avx2" ) ))
+    inline void toDoubleAVX2( double* dst, const unsigned char* src, std::size_t len )
+    {
+      std::size_t k = 0;
+      for ( ; k + 8 <= len; k += 8 )
+        {
+          const __m256i w = _mm256_cvtepu8_epi32( _mm_loadl_epi64( (const __m128i*)( src + k ) ) );
+          _mm256_storeu_pd( dst + k,     _mm256_cvtepi32_pd( _mm256_castsi256_si128( w ) ) );
+          _mm256_storeu_pd( dst + k + 4, _mm256_cvtepi32_pd( _mm256_extracti128_si256( w, 1 ) ) );
+        }
+      toDoubleSSE2( dst + k, src + k, len - k );
+    }
+
+    __attribute__(( target( "avx512f,avx512bw" ) ))
+    inline void toDoubleAVX512( double* dst, const unsigned char* src, std::size_t len )
+    {
+      std::size_t k = 0;
+      for ( ; k + 16 <= len; k += 16 )
+        {
+          const __m512i w = _mm512_cvtepu8_epi32( _mm_loadu_si128( (const __m128i*)( src + k ) ) );
+          _mm512_storeu_pd( dst + k,     _mm512_cvtepi32_pd( _mm512_castsi512_si256( w ) ) );
+          _mm512_storeu_pd( dst + k + 8, _mm512_cvtepi32_pd( _mm512_extracti64x4_epi64( w, 1 ) ) );
+        }
+      toDoubleAVX2( dst + k, src + k, len - k );
+    }
+#endif
+
+    /// The kernels chosen for the running CPU.
+    struct RowKernels {
+      RowFunction rowMax;
+      RowFunction rowMin;
+      PackFunction packGreater;
+      ConvertFunction toDouble;
+      const char* name;
+    };
+
+    /// @return the kernels best suited to the running CPU (chosen once).
+    inline const RowKernels& rowKernels()
+    {
+      static const RowKernels selected = [] () -> RowKernels
+      {
+#ifdef IPCV_X86_DISPATCH
+        __builtin_cpu_init();
+        if ( __builtin_cpu_supports( "avx512bw" ) )
+          return { rowMaxAVX512, rowMinAVX512, packGreaterAVX512, toDoubleAVX512, "AVX-512BW" };
+        if ( __builtin_cpu_supports( "avx2" ) )
+          return { rowMaxAVX2, rowMinAVX2, packGreaterAVX2, toDoubleAVX2, "AVX2" };
+        if ( __builtin_cpu_supports( "sse2" ) )
+          return { rowMaxSSE2, rowMinSSE2, packGreaterSSE2, toDoubleSSE2, "SSE2" };
+#endif
+        return { rowMaxScalar, rowMinScalar, packGreaterScalar, toDoubleScalar, "scalar" };
+      } ();
+      return selected;
+    }
+  } // namespace kernels
+
+  /// dst[ k ] = max( a[ k ], b[ k ] ) for k in [0,len). \a dst may be \a a or \a b.
+  inline void rowMax( unsigned char* dst, const unsigned char* a,
+                      const unsigned char* b, std::size_t len )
+  {
+    kernels::rowKernels().rowMax( dst, a, b, len );
+  }
+
+  /// dst[ k ] = min( a[ k ], b[ k ] ) for k in [0,len). \a dst may be \a a or \a b.
+  inline void rowMin( unsigned char* dst, const unsigned char* a,
+                      const unsigned char* b, std::size_t len )
+  {
+    kernels::rowKernels().rowMin( dst, a, b, len );
+  }
+
+  /// Bit j of dst[ w ] = ( src[ 64*w + j ] > t ) for w in [0,nb), i.e.
+  /// thresholds 64*nb values into nb words.
+  inline void packGreater( std::uint64_t* dst, const unsigned char* src,
+                           std::size_t nb, unsigned char t )
+  {
+    kernels::rowKernels().packGreater( dst, src, nb, t );
+  }
+
+  /// dst[ k ] = double( src[ k ] ) for k in [0,len).
+  inline void toDouble( double* dst, const unsigned char* src, std::size_t len )
+  {
+    kernels::rowKernels().toDouble( dst, src, len );
+  }
+} // namespace IPCV
@@ -0,0 +1,133 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file SliceExtractor.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Extraction of axis-aligned slices of a volume stored contiguously
+ * (x fastest), as arrays of double. A slice is listed with its first
+ * axis fastest, the first axis being y for x-slices and x otherwise.
+ *
+ * Slices of constant y or z are made of whole rows of x and are
+ * converted with the vectorized kernel toDouble. A slice of constant x
+ * reads one byte per row; TransposedVolume keeps a copy of the volume
+ * in which these slices are contiguous too.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "common/Morphology.h"
+#include "common/RowKernels.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// Copies in \a out the slice \a pos (0 is the lowest one)
+  /// orthogonal to \a axis of the volume \a data of extent \a e.
+  inline void extractSlice( const unsigned char* data, Extent e, int axis, int pos,
+                            double* out )
+  {
+    const std::size_t stride[ 3 ] = { 1, e.nx, e.nx * e.ny };
+    const std::size_t n[ 3 ]      = { e.nx, e.ny, e.nz };
+    const int i = ( axis == 0 ) ? 1 : 0; // first axis
+    const int j = ( axis == 2 ) ? 1 : 2; // second axis
+    const unsigned char* base = data + std::size_t( pos ) * stride[ axis ];
+    if ( axis == 2 ) // the slice is contiguous
+      toDouble( out, base, n[ i ] * n[ j ] );
+    else if ( axis == 1 ) // rows of x
+      for ( std::size_t y = 0; y < n[ j ]; y++ )
+        toDouble( out + y * n[ i ], base + y * stride[ j ], n[ i ] );
+    else // columns of y, one byte per row of x
+      for ( std::size_t y = 0; y < n[ j ]; y++ )
+        {
+          const unsigned char* p = base + y * stride[ j ];
+          double*            o = out + y * n[ i ];
+          for ( std::size_t x = 0; x < n[ i ]; x++, p += stride[ i ] ) o[ x ] = *p;
+        }
+  }
+
+  /// A transposed copy of a volume, in the order of its x-slices:
+  /// voxel (x,y,z) is at ( x * nz + z ) * ny + y, so that each slice of
+  /// constant x is contiguous and listed as extractSlice does.
+  class TransposedVolume
+  {
+  public:
+    /// Copies the volume \a data of extent \a e, which must outlive
+    /// this object (it is still read for slices of constant y or z).
+    void init( const unsigned char* data, Extent e )
+    {
+      my_source = data;
+      my_extent = e;
+      my_data.resize( e.size() );
+      transpose( 0, e.nz );
+    }
+
+    /// Parallel version of init, with the threads of \a pool.
+    void init( const unsigned char* data, Extent e, ThreadPool& pool )
+    {
+      my_source = data;
+      my_extent = e;
+      my_data.resize( e.size() );
+      pool.parallelFor( 0, e.nz, [&] ( std::size_t z0, std::size_t z1, std::size_t )
+                        { transpose( z0, z1 ); } );
+    }
+
+    /// @return the volume given at init.
+    const unsigned char* source() const { return my_source; }
+    Extent extent() const { return my_extent; }
+
+    /// Same as extractSlice on the source volume.
+    void extractSlice( int axis, int pos, double* out ) const
+    {
+      if ( axis != 0 )
+        IPCV::extractSlice( my_source, my_extent, axis, pos, out );
+      else
+        toDouble( out, my_data.data() + std::size_t( pos ) * my_extent.ny * my_extent.nz,
+                  my_extent.ny * my_extent.nz );
+    }
+
+  private:
+    /// Transposes slices [z0,z1) by tiles of B x B, reading rows of x
+    /// and writing columns of y.
+    void transpose( std::size_t z0, std::size_t z1 )
+    {
+      const std::size_t B  = 32;
+      const std::size_t nx = my_extent.nx, ny = my_extent.ny, nz = my_extent.nz;
+      for ( std::size_t z = z0; z < z1; z++ )
+        for ( std::size_t y0 = 0; y0 < ny; y0 += B )
+          for ( std::size_t x0 = 0; x0 < nx; x0 += B )
+            {
+              const std::size_t y1 = std::min( ny, y0 + B );
+              const std::size_t x1 = std::min( nx, x0 + B );
+              for ( std::size_t x = x0; x < x1; x++ )
+                {
+                  unsigned char*       dst = my_data.data() + ( x * nz + z ) * ny;
+                  const unsigned char* src = my_source + z * nx * ny + x;
+                  for ( std::size_t y = y0; y < y1; y++ ) dst[ y ] = src[ y * nx ];
+                }
+            }
+    }
+
+    const unsigned char*         my_source = nullptr;
+    Extent                       my_extent { 0, 0, 0 };
+    std::vector< unsigned char > my_data;
+  };
+} // namespace IPCV
@@ -0,0 +1,125 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file SliceView.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Display of an axis-aligned slice of a volume in polyscope. The grid
+ * mesh is registered once; moving the slice only changes the transform
+ * of the mesh and the values of its face quantity, kept in a
+ * persistent buffer.
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "polyscope/polyscope.h"
+#include "polyscope/surface_mesh.h"
+#include "polyscope/surface_scalar_quantity.h"
+
+#include "common/Morphology.h"
+#include "common/SliceExtractor.h"
+
+namespace IPCV
+{
+  /// A slice orthogonal to some axis of a volume, displayed as a grid
+  /// of quads colored by the intensities of the voxels.
+  class SliceView
+  {
+  public:
+    /// Registers the grid mesh \a name of the slices orthogonal to \a
+    /// axis of a volume of extent \a e, whose lowest voxel is \a lo.
+    void init( const std::string& name, Extent e, std::array< int, 3 > lo, int axis )
+    {
+      my_extent = e;
+      my_axis   = axis;
+      my_i      = ( axis == 0 ) ? 1 : 0; // first axis
+      my_j      = ( axis == 2 ) ? 1 : 2; // second axis
+      const std::size_t n[ 3 ] = { e.nx, e.ny, e.nz };
+      const std::size_t ni = n[ my_i ];
+      const std::size_t nj = n[ my_j ];
+      std::vector< std::array< double, 3 > > positions;
+      positions.reserve( ( ni + 1 ) * ( nj + 1 ) );
+      std::array< double, 3 > current;
+      current[ axis ] = lo[ axis ] + 0.5;
+      for ( std::size_t y = 0; y <= nj; y++ )
+        {
+          current[ my_j ] = double( lo[ my_j ] + int( y ) );
+          for ( std::size_t x = 0; x <= ni; x++ )
+            {
+              current[ my_i ] = double( lo[ my_i ] + int( x ) );
+              positions.push_back( current );
+            }
+        }
+      std::vector< std::array< std::size_t, 4 > > faces;
+      faces.reserve( ni * nj );
+      for ( std::size_t y = 0; y < nj; y++ )
+        for ( std::size_t x = 0; x < ni; x++ )
+          faces.push_back( { ( ni + 1 ) * y + x, ( ni + 1 ) * y + x + 1,
+                             ( ni + 1 ) * ( y + 1 ) + x + 1, ( ni + 1 ) * ( y + 1 ) + x } );
+      my_values.assign( ni * nj, 0.0 );
+      my_mesh = polyscope::registerSurfaceMesh( name, positions, faces );
+      my_quantity = my_mesh->addFaceScalarQuantity( "image intensities", my_values );
+      my_quantity->setMapRange( { 0.0, 255.0 } );
+      my_quantity->setEnabled( true );
+      my_pos = 0;
+    }
+
+    polyscope::SurfaceMesh* mesh() const { return my_mesh; }
+
+    /// Shows slice \a pos (0 is the lowest one) of the volume \a data,
+    /// which has the extent given at init.
+    void update( const unsigned char* data, int pos )
+    {
+      extractSlice( data, my_extent, my_axis, pos, my_values.data() );
+      show( pos );
+    }
+
+    /// Shows slice \a pos of \a volume, read from its
+    /// transposed copy for x-slices.
+    void update( const TransposedVolume& volume, int pos )
+    {
+      volume.extractSlice( my_axis, pos, my_values.data() );
+      show( pos );
+    }
+
+  private:
+    /// Sends the values to polyscope and moves the mesh to slice \a pos.
+    void show( int pos )
+    {
+      my_quantity->updateData( my_values );
+      if ( pos != my_pos )
+        {
+          glm::mat4 T( 1.0f );
+          T[ 3 ][ my_axis ] = float( pos );
+          my_mesh->setTransform( T );
+          my_pos = pos;
+        }
+    }
+
+    polyscope::SurfaceMesh*                my_mesh     = nullptr;
+    polyscope::SurfaceFaceScalarQuantity*  my_quantity = nullptr;
+    std::vector< double >                  my_values;
+    Extent                                 my_extent { 0, 0, 0 };
+    int                                    my_axis = 0, my_i = 1, my_j = 2;
+    int                                    my_pos  = 0;
+  };
+} // namespace IPCV
@@ -0,0 +1,307 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file SurfelExtraction.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Parallel extraction of the boundary surfels of a binary image and of
+ * their connected components. Each thread scans a slab of slices of
+ * constant z and links the surfels of its slab with a union-find; the
+ * links crossing slabs are merged afterwards.
+ *
+ * The surfels are the ones of Surfaces::sMakeBoundary (hence of
+ * SH3::makeDigitalSurface), and two surfels are linked when they are
+ * adjacent in the digital surface made of all of them, as in
+ * SetOfSurfels.
+ *
+ * All the surfels are stored, since linking looks them up. Components
+ * below a minimum size (typically noise) are counted, then dropped
+ * without ever copying their surfels. Those lying within one slab are
+ * already dropped after linking the slab, so that merging across slabs
+ * and grouping into components only visit the other ones.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <numeric>
+#include <utility>
+#include <vector>
+
+#include <DGtal/topology/SurfelAdjacency.h>
+#include <DGtal/topology/SurfelNeighborhood.h>
+
+#include "common/BlockRanges.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// The boundary surfels of a binary image, split into their
+  /// connected components.
+  /// @tparam TKSpace a 3d Khalimsky space, like Z3i::KSpace.
+  template < typename TKSpace >
+  class BoundaryComponents
+  {
+  public:
+    typedef TKSpace                                   KSpace;
+    typedef typename KSpace::Point                    Point;
+    typedef typename KSpace::SCell                    SCell;
+    typedef DGtal::SurfelAdjacency< KSpace::dimension > SurfelAdjacency;
+
+    /// Extracts the boundary of \a binary, an image of the domain of \a
+    /// K with operator()( Point ), and its components for the adjacency
+    /// \a adj, with the threads of \a pool. If \a blocks is not null,
+    /// the surfels are only searched in these blocks, which must
+    /// contain all the changes of value of \a binary. Only the
+    /// components of at least \a min_size surfels are built, and the
+    /// largest one. If \a stop is raised meanwhile, the extraction
+    /// stops at the next slice or surfel, with no component.
+    template < typename TBinaryImage >
+    void init( const KSpace& K, const SurfelAdjacency& adj,
+               const TBinaryImage& binary, ThreadPool& pool,
+               const BlockMask* blocks = nullptr, std::size_t min_size = 0,
+               const StopFlag* stop = nullptr )
+    {
+      my_components.clear();
+      my_nb_components = 0;
+      my_K  = &K;
+      my_lo = K.lowerBound();
+      my_up = K.upperBound();
+      const std::size_t nz = std::size_t( my_up[ 2 ] - my_lo[ 2 ] + 1 );
+      my_slabs.assign( pool.size(), std::vector< SCell >() );
+      my_slab_of_z.assign( nz, 0 );
+      pool.parallelFor( 0, nz, [&] ( std::size_t z0, std::size_t z1, std::size_t t )
+                        { scanSlab( binary, blocks, z0, z1, t, stop ); } );
+      if ( isStopped( stop ) ) return;
+      my_offsets.assign( my_slabs.size() + 1, 0 );
+      for ( std::size_t t = 0; t < my_slabs.size(); t++ )
+        my_offsets[ t + 1 ] = my_offsets[ t ] + my_slabs[ t ].size();
+      my_parent.resize( my_offsets.back() );
+      std::iota( my_parent.begin(), my_parent.end(), std::size_t( 0 ) );
+      // Links within slabs in parallel (each slab only touches its own
+      // part of my_parent), then links across slabs.
+      std::vector< std::vector< std::pair< std::size_t, std::size_t > > >
+        crossing( my_slabs.size() );
+      pool.parallelFor( 0, my_slabs.size(), [&] ( std::size_t t0, std::size_t t1, std::size_t )
+                        { for ( auto t = t0; t < t1; t++ ) linkSlab( adj, t, crossing[ t ], stop ); } );
+      if ( isStopped( stop ) ) return;
+      std::vector< std::size_t > nb_pruned( my_slabs.size(), 0 );
+      if ( min_size > 1 )
+        {
+          std::vector< char > crossed( my_parent.size(), 0 ); // roots linked to other slabs
+          for ( const auto& links : crossing )
+            for ( const auto& l : links ) crossed[ root( l.first ) ] = crossed[ root( l.second ) ] = 1;
+          pool.parallelFor( 0, my_slabs.size(), [&] ( std::size_t t0, std::size_t t1, std::size_t )
+                            { for ( auto t = t0; t < t1; t++ )
+                                nb_pruned[ t ] = pruneSlab( t, min_size, crossed ); } );
+        }
+      for ( const auto& links : crossing )
+        for ( const auto& l : links ) unite( l.first, l.second );
+      makeComponents( min_size,
+                      std::accumulate( nb_pruned.begin(), nb_pruned.end(), std::size_t( 0 ) ) );
+    }
+
+    /// @return the number of boundary surfels.
+    std::size_t size() const { return my_parent.size(); }
+
+    /// @return the number of components, including the dropped ones.
+    std::size_t nbComponents() const { return my_nb_components; }
+
+    /// @return the components that were built, sorted by decreasing size.
+    const std::vector< std::vector< SCell > >& components() const { return my_components; }
+
+  private:
+    static constexpr std::size_t npos = std::size_t( -1 );
+
+    /// @return the surfel between p and p+e_k, oriented by \a in.
+    SCell surfel( const Point& p, int k, bool in ) const
+    {
+      Point kp;
+      for ( int i = 0; i < 3; i++ ) kp[ i ] = 2 * p[ i ] + ( i == k ? 2 : 1 );
+      return my_K->sCell( kp, in );
+    }
+
+    /// Collects the boundary surfels of the voxels of slices [z0,z1)
+    /// in slab \a t, sorted for lookup.
+    template < typename TBinaryImage >
+    void scanSlab( const TBinaryImage& binary, const BlockMask* blocks,
+                   std::size_t z0, std::size_t z1, std::size_t t, const StopFlag* stop )
+    {
+      auto& surfels = my_slabs[ t ];
+      const std::size_t nx = std::size_t( my_up[ 0 ] - my_lo[ 0 ] + 1 );
+      Point p;
+      for ( std::size_t z = z0; z < z1; z++ )
+        {
+          my_slab_of_z[ z ] = t;
+          if ( isStopped( stop ) ) break;
+          p[ 2 ] = my_lo[ 2 ] + typename Point::Component( z );
+          for ( p[ 1 ] = my_lo[ 1 ]; p[ 1 ] <= my_up[ 1 ]; p[ 1 ]++ )
+            {
+              const std::size_t y = std::size_t( p[ 1 ] - my_lo[ 1 ] );
+              for ( std::size_t x = nextActive( blocks, 0, y, z, nx ); x < nx;
+                    x = nextActive( blocks, x + 1, y, z, nx ) )
+                {
+                  p[ 0 ] = my_lo[ 0 ] + typename Point::Component( x );
+                  const bool in = binary( p );
+                  for ( int k = 0; k < 3; k++ )
+                    if ( p[ k ] < my_up[ k ] )
+                      {
+                        Point q = p; q[ k ]++;
+                        if ( in != binary( q ) ) surfels.push_back( surfel( p, k, in ) );
+                      }
+                }
+            }
+        }
+      std::sort( surfels.begin(), surfels.end() );
+    }
+
+    /// @return the index of surfel \a s, or npos if it is not a
+    /// boundary surfel. A surfel belongs to the slab of its voxel of
+    /// lowest coordinates.
+    std::size_t find( const SCell& s ) const
+    {
+      const auto kz = my_K->sKCoords( s )[ 2 ];
+      const auto z  = ( ( kz - 1 ) >> 1 ) - my_lo[ 2 ]; // 2z+1 or 2z+2
+      if ( z < 0 || z > my_up[ 2 ] - my_lo[ 2 ] ) return npos;
+      const std::size_t t  = my_slab_of_z[ std::size_t( z ) ];
+      const auto&       v  = my_slabs[ t ];
+      const auto        it = std::lower_bound( v.begin(), v.end(), s );
+      if ( it == v.end() || ! ( *it == s ) ) return npos;
+      return my_offsets[ t ] + std::size_t( it - v.begin() );
+    }
+
+    /// Links the surfels of slab \a t to their adjacent surfels, storing
+    /// in \a crossing the links to other slabs.
+    void linkSlab( const SurfelAdjacency& adj, std::size_t t,
+                   std::vector< std::pair< std::size_t, std::size_t > >& crossing,
+                   const StopFlag* stop )
+    {
+      const std::size_t b = my_offsets[ t ];
+      const std::size_t e = my_offsets[ t + 1 ];
+      std::size_t found = npos;
+      auto isBoundary = [&] ( const SCell& s ) { found = find( s ); return found != npos; };
+      DGtal::SurfelNeighborhood< KSpace > SN;
+      for ( std::size_t i = b; i < e && ! isStopped( stop ); i++ )
+        {
+          const SCell& s = my_slabs[ t ][ i - b ];
+          SN.init( my_K, &adj, s );
+          for ( auto q = my_K->sDirs( s ); q != 0; ++q )
+            for ( bool pos : { true, false } )
+              {
+                SCell neighbor;
+                if ( SN.getAdjacentOnSurfels( neighbor, isBoundary, *q, pos ) == 0 ) continue;
+                if ( b <= found && found < e ) unite( i, found );
+                else crossing.push_back( { i, found } );
+              }
+        }
+    }
+
+    std::size_t root( std::size_t i )
+    {
+      while ( my_parent[ i ] != i )
+        i = my_parent[ i ] = my_parent[ my_parent[ i ] ]; // path halving
+      return i;
+    }
+
+    void unite( std::size_t i, std::size_t j )
+    {
+      i = root( i ); j = root( j );
+      if ( i != j ) my_parent[ std::max( i, j ) ] = std::min( i, j );
+    }
+
+    /// Drops the components of slab \a t that are not \a crossed by
+    /// links to other slabs and have less than \a min_size surfels,
+    /// by setting the parent of their surfels to npos. The largest of
+    /// them is kept, since it may be the largest component.
+    /// @return the number of dropped components.
+    std::size_t pruneSlab( std::size_t t, std::size_t min_size,
+                           const std::vector< char >& crossed )
+    {
+      const std::size_t b = my_offsets[ t ];
+      const std::size_t e = my_offsets[ t + 1 ];
+      std::vector< std::size_t > roots( e - b ), sizes( e - b, 0 );
+      for ( std::size_t i = b; i < e; i++ )
+        sizes[ ( roots[ i - b ] = root( i ) ) - b ]++;
+      auto isSmall = [&] ( std::size_t r )
+        { return ! crossed[ r ] && sizes[ r - b ] < min_size; };
+      // Roots are the first surfels of their components, so that ties
+      // are broken as in makeComponents.
+      std::size_t largest = npos;
+      for ( std::size_t i = b; i < e; i++ )
+        if ( roots[ i - b ] == i && isSmall( i )
+             && ( largest == npos || sizes[ i - b ] > sizes[ largest - b ] ) )
+          largest = i;
+      std::size_t nb = 0;
+      for ( std::size_t i = b; i < e; i++ )
+        {
+          const std::size_t r = roots[ i - b ];
+          if ( r == largest || ! isSmall( r ) ) continue;
+          if ( r == i ) nb++;
+          my_parent[ i ] = npos;
+        }
+      return nb;
+    }
+
+    /// Groups the surfels by root, largest components first, keeping
+    /// the largest component and those of at least \a min_size surfels.
+    /// The \a nb_pruned components dropped by pruneSlab are only counted.
+    void makeComponents( std::size_t min_size, std::size_t nb_pruned )
+    {
+      std::vector< std::size_t > label( my_parent.size(), npos );
+      std::vector< std::size_t > sizes;
+      for ( std::size_t i = 0; i < my_parent.size(); i++ )
+        {
+          if ( my_parent[ i ] == npos ) continue; // dropped by pruneSlab
+          const std::size_t r = root( i );
+          if ( label[ r ] == npos ) { label[ r ] = sizes.size(); sizes.push_back( 0 ); }
+          label[ i ] = label[ r ];
+          sizes[ label[ i ] ]++;
+        }
+      std::vector< std::size_t > order( sizes.size() );
+      std::iota( order.begin(), order.end(), std::size_t( 0 ) );
+      std::stable_sort( order.begin(), order.end(), [&] ( std::size_t a, std::size_t c )
+                        { return sizes[ a ] > sizes[ c ]; } );
+      std::size_t nb_kept = 0;
+      while ( nb_kept < order.size()
+              && ( nb_kept == 0 || sizes[ order[ nb_kept ] ] >= min_size ) )
+        nb_kept++;
+      std::vector< std::size_t > rank( order.size(), npos ); // npos if dropped
+      for ( std::size_t r = 0; r < nb_kept; r++ ) rank[ order[ r ] ] = r;
+      my_nb_components = sizes.size() + nb_pruned;
+      my_components.assign( nb_kept, std::vector< SCell >() );
+      for ( std::size_t r = 0; r < nb_kept; r++ )
+        my_components[ r ].reserve( sizes[ order[ r ] ] );
+      for ( std::size_t t = 0; t < my_slabs.size(); t++ )
+        for ( std::size_t i = 0; i < my_slabs[ t ].size(); i++ )
+          {
+            const std::size_t l = label[ my_offsets[ t ] + i ];
+            const std::size_t r = l == npos ? npos : rank[ l ];
+            if ( r != npos ) my_components[ r ].push_back( my_slabs[ t ][ i ] );
+          }
+    }
+
+    const KSpace*                        my_K = nullptr;
+    Point                                my_lo, my_up;
+    std::vector< std::vector< SCell > >  my_slabs;      // sorted surfels of each slab
+    std::vector< std::size_t >           my_slab_of_z;  // slab of each slice
+    std::vector< std::size_t >           my_offsets;    // index of the first surfel of each slab
+    std::vector< std::size_t >           my_parent;     // union-find over surfel indices
+    std::vector< std::vector< SCell > >  my_components; // the kept ones
+    std::size_t                          my_nb_components = 0;
+  };
+} // namespace IPCV
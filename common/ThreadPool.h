@@ -0,0 +1,147 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file ThreadPool.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * A minimal pool of persistent worker threads, used to run loops over
+ * slabs of a volume in parallel.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace IPCV
+{
+  /// A flag raised by another thread to ask a long computation to
+  /// stop early. Loops over slabs check it between slices.
+  typedef std::atomic< bool > StopFlag;
+
+  /// @return 'true' if \a stop is not null and has been raised.
+  inline bool isStopped( const StopFlag* stop )
+  { return stop != nullptr && stop->load( std::memory_order_relaxed ); }
+
+  /// A pool of threads. The calling thread always takes part in the
+  /// work, so a pool of size 1 has no worker and runs everything
+  /// sequentially. Loops are handed to the workers without any heap
+  /// allocation, so that they can be called in tight loops.
+  ///
+  /// @note parallelFor must be called by one thread at a time, and
+  /// not from inside another parallelFor of the same pool.
+  class ThreadPool
+  {
+  public:
+    /// Creates a pool that uses \a nb threads (0 means all hardware threads).
+    explicit ThreadPool( std::size_t nb = 1 ) { resize( nb ); }
+    ~ThreadPool() { stop(); }
+    ThreadPool( const ThreadPool& ) = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    /// @return the number of threads taking part in parallel loops.
+    std::size_t size() const { return my_workers.size() + 1; }
+
+    /// Changes the number of threads (0 means all hardware threads).
+    void resize( std::size_t nb )
+    {
+      if ( nb == 0 ) nb = std::max( 1u, std::thread::hardware_concurrency() );
+      stop();
+      my_stop = false;
+      for ( std::size_t i = 1; i < nb; i++ )
+        my_workers.emplace_back( [this, i, g = my_generation] { work( i, g ); } );
+    }
+
+    /// Calls f( b, e, t ) on at most size() contiguous chunks [b,e)
+    /// of [begin,end), where t is the index of the chunk, and waits
+    /// until all of them are done.
+    template < typename Function >
+    void parallelFor( std::size_t begin, std::size_t end, Function f )
+    {
+      if ( end <= begin ) return;
+      const std::size_t n  = end - begin;
+      const std::size_t nb = std::min( size(), n );
+      auto chunk = [&] ( std::size_t t )
+      {
+        f( begin + n * t / nb, begin + n * ( t + 1 ) / nb, t );
+      };
+      if ( nb == 1 ) { chunk( 0 ); return; }
+      typedef decltype( chunk ) Chunk;
+      {
+        std::lock_guard< std::mutex > lock( my_mutex );
+        my_run       = [] ( const void* c, std::size_t t )
+        { ( *static_cast< const Chunk* >( c ) )( t ); };
+        my_context   = &chunk;
+        my_nb        = nb;
+        my_remaining = nb - 1;
+        my_generation++;
+      }
+      my_wakeup.notify_all();
+      chunk( 0 );
+      std::unique_lock< std::mutex > lock( my_mutex );
+      my_done.wait( lock, [this] { return my_remaining == 0; } );
+    }
+
+  private:
+    /// Loop of the i-th worker, which runs chunk i of each job
+    /// posted after generation \a seen.
+    void work( std::size_t i, std::size_t seen )
+    {
+      std::unique_lock< std::mutex > lock( my_mutex );
+      for ( ;; )
+        {
+          my_wakeup.wait( lock, [&] { return my_stop || my_generation != seen; } );
+          if ( my_stop ) return;
+          seen = my_generation;
+          if ( i >= my_nb ) continue;
+          auto run     = my_run;
+          auto context = my_context;
+          lock.unlock();
+          run( context, i );
+          lock.lock();
+          if ( --my_remaining == 0 ) my_done.notify_all();
+        }
+    }
+
+    void stop()
+    {
+      {
+        std::lock_guard< std::mutex > lock( my_mutex );
+        my_stop = true;
+      }
+      my_wakeup.notify_all();
+      for ( auto& w : my_workers ) w.join();
+      my_workers.clear();
+    }
+
+    std::vector< std::thread > my_workers;
+    std::mutex                 my_mutex;
+    std::condition_variable    my_wakeup;
+    std::condition_variable    my_done;
+    void (*my_run)( const void*, std::size_t ) = nullptr;
+    const void*                my_context    = nullptr;
+    std::size_t                my_nb         = 0;
+    std::size_t                my_remaining  = 0;
+    std::size_t                my_generation = 0;
+    bool                       my_stop       = false;
+  };
+} // namespace IPCV
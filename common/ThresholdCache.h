@@ -0,0 +1,226 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file ThresholdCache.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Incremental thresholding of a gray-scale image. The voxels are
+ * sorted once by value (counting sort), so that changing the threshold
+ * from t to t' only visits the voxels whose value lies between t and
+ * t', and only updates the boundary surfels around them.
+ *
+ * The sorted indices take 4 bytes per voxel (about 270 MB for 67M
+ * voxels), on top of the binary image. The cache is keyed on the
+ * generation of the image (see ImageGenerations), not on the address
+ * of its values, which may be reused by another image.
+ */
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "common/BlockRanges.h"
+#include "common/ImageGenerations.h"
+
+namespace IPCV
+{
+  /// The indices of the voxels of an image, sorted by value, with the
+  /// histogram of the values.
+  class SortedVoxels
+  {
+  public:
+    /// Sorts the \a n values of \a data (at most 2^32 voxels).
+    void init( const unsigned char* data, std::size_t n )
+    {
+      my_histogram.fill( 0 );
+      for ( std::size_t k = 0; k < n; k++ ) my_histogram[ data[ k ] ]++;
+      my_offsets[ 0 ] = 0;
+      for ( int v = 0; v < 256; v++ )
+        my_offsets[ v + 1 ] = my_offsets[ v ] + my_histogram[ v ];
+      std::array< std::size_t, 257 > next = my_offsets;
+      my_indices.resize( n );
+      for ( std::size_t k = 0; k < n; k++ )
+        my_indices[ next[ data[ k ] ]++ ] = std::uint32_t( k );
+    }
+
+    /// @return the number of voxels of each value.
+    const std::array< std::size_t, 256 >& histogram() const { return my_histogram; }
+
+    /// @return the position of the first voxel of value > t, so that
+    /// voxels of value in (lo,hi] are [ above( lo ), above( hi ) ).
+    const std::uint32_t* above( int t ) const
+    { return my_indices.data() + my_offsets[ clamp( t ) ]; }
+
+  private:
+    /// @return the number of values <= t.
+    static std::size_t clamp( int t ) { return std::size_t( std::min( std::max( t + 1, 0 ), 256 ) ); }
+
+    std::array< std::size_t, 256 > my_histogram;
+    std::array< std::size_t, 257 > my_offsets;
+    std::vector< std::uint32_t >   my_indices;
+  };
+
+  /// Keeps a binary image equal to ( data > t ), and optionally the set
+  /// of its boundary surfels, while t changes.
+  ///
+  /// A surfel between voxels x and x+e_k (both in the domain) is a
+  /// boundary surfel if exactly one of them is in the binary image; it
+  /// is positively oriented iff x is the one inside, as in
+  /// Surfaces::sMakeBoundary.
+  ///
+  /// @tparam TKSpace a 3d Khalimsky space, like Z3i::KSpace.
+  /// @tparam TBinaryImage a binary image with operator() and setValue,
+  /// like SH3::BinaryImage or PackedBinaryImage.
+  template < typename TKSpace, typename TBinaryImage >
+  class ThresholdCache
+  {
+  public:
+    typedef TKSpace                        KSpace;
+    typedef TBinaryImage                   BinaryImage;
+    typedef typename KSpace::Point         Point;
+    typedef typename KSpace::SCell         SCell;
+    typedef typename KSpace::SurfelSet     SurfelSet;
+
+    /// Sorts the voxels of \a data, an image of generation \a
+    /// generation whose domain is the one of \a K, and computes the
+    /// boundary of \a binary if \a track_boundary. \a K and \a binary
+    /// must outlive the cache, and \a binary must already be the
+    /// threshold of \a data at \a t. If \a blocks is not null, the
+    /// boundary is only searched in these blocks of \a data, which must
+    /// be the ones straddling t.
+    void init( const KSpace& K, const unsigned char* data, std::uint64_t generation,
+               BinaryImage& binary, int t, bool track_boundary,
+               const BlockMask* blocks = nullptr )
+    {
+      my_K          = &K;
+      my_generation = generation;
+      my_binary     = &binary;
+      my_t          = t;
+      my_track      = track_boundary;
+      const Point d = K.upperBound() - K.lowerBound();
+      my_nx = std::size_t( d[ 0 ] + 1 );
+      my_ny = std::size_t( d[ 1 ] + 1 );
+      my_nz = std::size_t( d[ 2 ] + 1 );
+      my_sorted.init( data, my_nx * my_ny * my_nz );
+      my_surfels.clear();
+      if ( ! my_track ) return;
+      const Point lo = K.lowerBound();
+      const Point up = K.upperBound();
+      Point p;
+      for ( p[ 2 ] = lo[ 2 ]; p[ 2 ] <= up[ 2 ]; p[ 2 ]++ )
+        for ( p[ 1 ] = lo[ 1 ]; p[ 1 ] <= up[ 1 ]; p[ 1 ]++ )
+          for ( std::size_t x = next( blocks, 0, p ); x < my_nx; x = next( blocks, x + 1, p ) )
+            {
+              p[ 0 ] = lo[ 0 ] + typename Point::Component( x );
+              const bool in = binary( p );
+              for ( int k = 0; k < 3; k++ )
+                if ( p[ k ] < up[ k ] )
+                  {
+                    Point q = p; q[ k ]++;
+                    if ( in != binary( q ) ) my_surfels.insert( surfel( p, k, in ) );
+                  }
+            }
+    }
+
+    /// Forgets the image, so that isValid is false for any generation.
+    void invalidate() { my_generation = ImageGenerations::NONE; }
+
+    /// @return 'true' if the cache was initialized with the image of
+    /// generation \a generation.
+    bool isValid( std::uint64_t generation ) const
+    { return my_generation != ImageGenerations::NONE && my_generation == generation; }
+
+    int threshold() const { return my_t; }
+    const SurfelSet& surfels() const { return my_surfels; }
+    const std::array< std::size_t, 256 >& histogram() const { return my_sorted.histogram(); }
+
+    /// Changes the threshold to \a t, updating the binary image (and
+    /// the boundary) only around the voxels of value between the old
+    /// and the new threshold. @return the number of changed voxels.
+    std::size_t setThreshold( int t )
+    {
+      const int  lo    = std::min( t, my_t );
+      const int  hi    = std::max( t, my_t );
+      const bool value = t < my_t; // voxels in (lo,hi] enter when t decreases
+      my_t = t;
+      const std::uint32_t* b = my_sorted.above( lo );
+      const std::uint32_t* e = my_sorted.above( hi );
+      for ( auto it = b; it != e; ++it ) my_binary->setValue( point( *it ), value );
+      if ( my_track )
+        for ( auto it = b; it != e; ++it ) updateSurfels( point( *it ) );
+      return std::size_t( e - b );
+    }
+
+  private:
+    /// @return the first voxel of the row of \a p from \a x in an
+    /// active block.
+    std::size_t next( const BlockMask* blocks, std::size_t x, const Point& p ) const
+    {
+      const Point q = p - my_K->lowerBound();
+      return nextActive( blocks, x, std::size_t( q[ 1 ] ), std::size_t( q[ 2 ] ), my_nx );
+    }
+
+    /// @return the point of linear index \a k.
+    Point point( std::size_t k ) const
+    {
+      Point p = my_K->lowerBound();
+      p[ 0 ] += typename Point::Component( k % my_nx );
+      p[ 1 ] += typename Point::Component( ( k / my_nx ) % my_ny );
+      p[ 2 ] += typename Point::Component( k / ( my_nx * my_ny ) );
+      return p;
+    }
+
+    /// @return the surfel between p and p+e_k, oriented by \a in.
+    SCell surfel( const Point& p, int k, bool in ) const
+    {
+      Point kp;
+      for ( int i = 0; i < 3; i++ ) kp[ i ] = 2 * p[ i ] + ( i == k ? 2 : 1 );
+      return my_K->sCell( kp, in );
+    }
+
+    /// Recomputes the six surfels around voxel \a p.
+    void updateSurfels( const Point& p )
+    {
+      const Point lo = my_K->lowerBound();
+      const Point up = my_K->upperBound();
+      for ( int k = 0; k < 3; k++ )
+        for ( int s = -1; s <= 0; s++ )
+          { // pair ( q, q+e_k ) with q = p - e_k, then q = p.
+            Point q = p; q[ k ] += s;
+            if ( q[ k ] < lo[ k ] || q[ k ] >= up[ k ] ) continue;
+            Point r = q; r[ k ]++;
+            const bool in = (*my_binary)( q );
+            my_surfels.erase( surfel( q, k, ! in ) );
+            if ( in != (*my_binary)( r ) ) my_surfels.insert( surfel( q, k, in ) );
+            else                           my_surfels.erase( surfel( q, k, in ) );
+          }
+    }
+
+    const KSpace*        my_K          = nullptr;
+    std::uint64_t        my_generation = ImageGenerations::NONE;
+    BinaryImage*         my_binary     = nullptr;
+    int                  my_t          = 0;
+    bool                 my_track      = false;
+    std::size_t          my_nx = 0, my_ny = 0, my_nz = 0;
+    SortedVoxels         my_sorted;
+    SurfelSet            my_surfels;
+  };
+} // namespace IPCV
@@ -0,0 +1,233 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file VolStream.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Sequential reading and writing of .vol files by slices of constant
+ * z, so that a volume can be processed without being fully loaded in
+ * memory. Both raw (Version 2) and zlib-compressed (Version 3) files
+ * are supported, voxels being unsigned char with x as fastest axis.
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace IPCV
+{
+  /// The text header of a .vol file, made of "Key: value" lines and
+  /// ended by a line ".".
+  struct VolHeader {
+    std::size_t nx = 0, ny = 0, nz = 0;
+    int version = 3;
+
+    /// @return the number of voxels of one z-slice.
+    std::size_t sliceSize() const { return nx * ny; }
+
+    /// Reads the header from \a in. @return 'true' if it is valid.
+    bool read( std::istream& in )
+    {
+      std::string line;
+      while ( std::getline( in, line ) )
+        {
+          if ( line == "." )
+            return nx > 0 && ny > 0 && nz > 0 && ( version == 2 || version == 3 );
+          const auto sep = line.find( ": " );
+          if ( sep == std::string::npos ) return false;
+          const std::string key   = line.substr( 0, sep );
+          const long        value = std::atol( line.c_str() + sep + 2 );
+          if      ( key == "X" )       nx      = value;
+          else if ( key == "Y" )       ny      = value;
+          else if ( key == "Z" )       nz      = value;
+          else if ( key == "Version" ) version = int( value );
+        }
+      return false;
+    }
+
+    /// Writes the header as DGtal does.
+    void write( std::ostream& out ) const
+    {
+      out << "Center-X: " << ( nx - 1 ) / 2 << "\n"
+          << "Center-Y: " << ( ny - 1 ) / 2 << "\n"
+          << "Center-Z: " << ( nz - 1 ) / 2 << "\n"
+          << "X: " << nx << "\n" << "Y: " << ny << "\n" << "Z: " << nz << "\n"
+          << "Voxel-Size: 1\n" << "Alpha-Color: 0\n"
+          << "Voxel-Endian: 0\n" << "Int-Endian: 0123\n"
+          << "Version: " << version << "\n" << ".\n";
+    }
+  };
+
+  /// Reads the z-slices of a .vol file one after the other.
+  class VolSliceReader
+  {
+  public:
+    VolSliceReader() = default;
+    ~VolSliceReader() { if ( my_compressed ) inflateEnd( &my_zs ); }
+    VolSliceReader( const VolSliceReader& ) = delete;
+    VolSliceReader& operator=( const VolSliceReader& ) = delete;
+
+    /// Opens \a filename and reads its header. @return 'true' if ok.
+    bool open( const std::string& filename )
+    {
+      my_in.open( filename, std::ios::binary );
+      if ( ! my_in.good() || ! my_header.read( my_in ) ) return false;
+      my_compressed = my_header.version == 3;
+      my_z = 0;
+      if ( my_compressed )
+        {
+          my_zs = z_stream();
+          my_input.resize( 1 << 18 );
+          if ( inflateInit( &my_zs ) != Z_OK ) { my_compressed = false; return false; }
+        }
+      return true;
+    }
+
+    const VolHeader& header() const { return my_header; }
+
+    /// @return the index of the next slice to be read.
+    std::size_t position() const { return my_z; }
+
+    /// Reads at most \a nb slices into \a buffer, which must have room
+    /// for nb * header().sliceSize() values.
+    /// @return the number of slices read (less than nb only at the end or on error).
+    std::size_t read( unsigned char* buffer, std::size_t nb )
+    {
+      nb = std::min( nb, my_header.nz - my_z );
+      const std::size_t bytes = nb * my_header.sliceSize();
+      if ( ! my_compressed )
+        {
+          my_in.read( reinterpret_cast< char* >( buffer ), bytes );
+          const std::size_t done = my_in.gcount() / my_header.sliceSize();
+          my_z += done;
+          return done;
+        }
+      my_zs.next_out  = buffer;
+      my_zs.avail_out = uInt( bytes );
+      while ( my_zs.avail_out > 0 )
+        {
+          if ( my_zs.avail_in == 0 )
+            {
+              my_in.read( reinterpret_cast< char* >( my_input.data() ), my_input.size() );
+              my_zs.next_in  = my_input.data();
+              my_zs.avail_in = uInt( my_in.gcount() );
+              if ( my_zs.avail_in == 0 ) break;
+            }
+          const int status = inflate( &my_zs, Z_NO_FLUSH );
+          if ( status == Z_STREAM_END ) break;
+          if ( status != Z_OK ) break;
+        }
+      const std::size_t done = ( bytes - my_zs.avail_out ) / my_header.sliceSize();
+      my_z += done;
+      return done;
+    }
+
+  private:
+    std::ifstream                my_in;
+    VolHeader                    my_header;
+    bool                         my_compressed = false;
+    z_stream                     my_zs         = z_stream();
+    std::vector< unsigned char > my_input;
+    std::size_t                  my_z = 0;
+  };
+
+  /// Writes the z-slices of a .vol file one after the other.
+  class VolSliceWriter
+  {
+  public:
+    VolSliceWriter() = default;
+    ~VolSliceWriter() { close(); }
+    VolSliceWriter( const VolSliceWriter& ) = delete;
+    VolSliceWriter& operator=( const VolSliceWriter& ) = delete;
+
+    /// Creates \a filename and writes \a header. @return 'true' if ok.
+    bool open( const std::string& filename, const VolHeader& header )
+    {
+      my_header = header;
+      my_out.open( filename, std::ios::binary );
+      if ( ! my_out.good() ) return false;
+      my_header.write( my_out );
+      my_compressed = my_header.version == 3;
+      if ( my_compressed )
+        {
+          my_zs = z_stream();
+          my_output.resize( 1 << 18 );
+          if ( deflateInit( &my_zs, Z_DEFAULT_COMPRESSION ) != Z_OK )
+            { my_compressed = false; return false; }
+        }
+      my_open = true;
+      return my_out.good();
+    }
+
+    /// Writes \a nb slices from \a buffer. @return 'true' if ok.
+    bool write( const unsigned char* buffer, std::size_t nb )
+    {
+      const std::size_t bytes = nb * my_header.sliceSize();
+      if ( ! my_compressed )
+        my_out.write( reinterpret_cast< const char* >( buffer ), bytes );
+      else
+        {
+          my_zs.next_in  = const_cast< unsigned char* >( buffer );
+          my_zs.avail_in = uInt( bytes );
+          deflateAll( Z_NO_FLUSH );
+        }
+      return my_out.good();
+    }
+
+    /// Flushes and closes the file. @return 'true' if everything was written.
+    bool close()
+    {
+      if ( ! my_open ) return true;
+      my_open = false;
+      if ( my_compressed )
+        {
+          deflateAll( Z_FINISH );
+          deflateEnd( &my_zs );
+          my_compressed = false;
+        }
+      my_out.close();
+      return ! my_out.fail();
+    }
+
+  private:
+    void deflateAll( int flush )
+    {
+      int status;
+      do {
+        my_zs.next_out  = my_output.data();
+        my_zs.avail_out = uInt( my_output.size() );
+        status = deflate( &my_zs, flush );
+        my_out.write( reinterpret_cast< const char* >( my_output.data() ),
+                      my_output.size() - my_zs.avail_out );
+      } while ( my_zs.avail_out == 0 || ( flush == Z_FINISH && status == Z_OK ) );
+    }
+
+    std::ofstream                my_out;
+    VolHeader                    my_header;
+    bool                         my_open       = false;
+    bool                         my_compressed = false;
+    z_stream                     my_zs         = z_stream();
+    std::vector< unsigned char > my_output;
+  };
+} // namespace IPCV
@@ -0,0 +1,332 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file VoxelComponents.h
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Parallel labeling of the 6-, 18- or 26-connected components of the
+ * voxels of a binary volume, with their sizes and bounding boxes.
+ *
+ * The volume is split into slabs along z. Each thread links the voxels
+ * of its slab to their previous neighbors with a union-find over voxel
+ * indices, the root of a tree being its voxel of smallest index. The
+ * slabs are then merged across their faces with a lock-free union-find
+ * (roots are linked by compare-exchange), trees are flattened, and
+ * components are numbered and measured in a last pass.
+ */
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+
+namespace IPCV
+{
+  /// The connected components of the voxels of a binary volume of less
+  /// than 2^31 voxels.
+  class VoxelComponents
+  {
+  public:
+    typedef std::uint32_t Label; // 0 for background voxels
+
+    /// The number of voxels and the bounding box of a component.
+    struct Component {
+      std::size_t size;
+      std::size_t lo[ 3 ], hi[ 3 ];
+    };
+
+    /// Labels the voxels of \a binary, a binary image stored as
+    /// ImageContainerBySTLVector (like SH3::BinaryImage), for the
+    /// \a adjacency (6, 18 or 26) with the threads of \a pool.
+    template < typename TBinaryImage >
+    void init( const TBinaryImage& binary, int adjacency, ThreadPool& pool )
+    {
+      const auto voxels = binary.begin();
+      init( [voxels] ( std::size_t i ) { return bool( voxels[ i ] ); },
+            extent( binary ), adjacency, pool );
+    }
+
+    /// Labels the voxels i of a volume of extent \a e such that \a
+    /// inside( i ) is true, for the \a adjacency (6, 18 or 26) with the
+    /// threads of \a pool.
+    template < typename Predicate >
+    void init( Predicate inside, Extent e, int adjacency, ThreadPool& pool )
+    {
+      my_extent = e;
+      setNeighbors( adjacency );
+      my_labels.resize( e.size() );
+      // Links within slabs.
+      std::vector< std::size_t > first_z( pool.size() + 1, e.nz );
+      pool.parallelFor( 0, e.nz, [&] ( std::size_t z0, std::size_t z1, std::size_t t )
+      {
+        first_z[ t ] = z0;
+        linkSlab( inside, z0, z1 );
+      } );
+      // Links across the faces between slabs.
+      pool.parallelFor( 1, pool.size(), [&] ( std::size_t t0, std::size_t t1, std::size_t )
+      {
+        for ( std::size_t t = t0; t < t1; t++ )
+          if ( first_z[ t ] < e.nz ) linkFace( first_z[ t ] );
+      } );
+      // Numbers the roots in index order, then labels all the voxels.
+      const std::size_t n = e.size();
+      std::vector< std::size_t > nb_roots( pool.size() + 1, 0 );
+      pool.parallelFor( 0, n, [&] ( std::size_t i0, std::size_t i1, std::size_t t )
+      {
+        for ( std::size_t i = i0; i < i1; i++ )
+          if ( my_labels[ i ] != NONE )
+            {
+              const Label r = find( Label( i ) );
+              store( i, r );
+              if ( r == i ) nb_roots[ t + 1 ]++;
+            }
+      } );
+      for ( std::size_t t = 0; t < pool.size(); t++ ) nb_roots[ t + 1 ] += nb_roots[ t ];
+      pool.parallelFor( 0, n, [&] ( std::size_t i0, std::size_t i1, std::size_t t )
+      {
+        Label l = Label( nb_roots[ t ] );
+        for ( std::size_t i = i0; i < i1; i++ )
+          if ( my_labels[ i ] == i ) my_labels[ i ] = ROOT | ++l;
+      } );
+      my_components.assign( nb_roots[ pool.size() ], Component { 0, { n, n, n }, { 0, 0, 0 } } );
+      pool.parallelFor( 0, e.ny * e.nz, [&] ( std::size_t r0, std::size_t r1, std::size_t )
+                        { labelRows( r0, r1 ); } );
+    }
+
+    /// @return the number of components.
+    std::size_t size() const { return my_components.size(); }
+
+    /// @return the label of the voxel of index \a i, 0 if it is not inside.
+    Label label( std::size_t i ) const { return my_labels[ i ]; }
+
+    /// @return the component of label \a l (from 1 to size()).
+    const Component& component( Label l ) const { return my_components[ l - 1 ]; }
+
+    const std::vector< Component >& components() const { return my_components; }
+
+    /// Sets \a out, a volume of the same extent, to 255 for the voxels
+    /// of the components of at least \a min_size voxels, and to 0
+    /// elsewhere.
+    void select( unsigned char* out, std::size_t min_size, ThreadPool& pool ) const
+    {
+      pool.parallelFor( 0, my_labels.size(), [&] ( std::size_t i0, std::size_t i1, std::size_t )
+      {
+        for ( std::size_t i = i0; i < i1; i++ )
+          {
+            const Label l = my_labels[ i ];
+            out[ i ] = l != 0 && component( l ).size >= min_size ? 255 : 0;
+          }
+      } );
+    }
+
+  private:
+    static constexpr Label NONE = Label( -1 );           // background during labeling
+    static constexpr Label ROOT = Label( 1 ) << 31;      // marks the labels of roots
+
+    typedef std::atomic_ref< Label >       AtomicLabel;
+    typedef std::atomic_ref< std::size_t > AtomicSize;
+
+    /// A previous neighbor (smaller index), and its offset.
+    struct Neighbor { int dx, dy, dz; std::size_t offset; };
+
+    /// Computes the previous neighbors for the \a adjacency, and the
+    /// ones that are not neighbors of the voxel x-1 as well.
+    void setNeighbors( int adjacency )
+    {
+      const int max_nonzero = adjacency == 6 ? 1 : adjacency == 18 ? 2 : 3;
+      auto adjacent = [max_nonzero] ( int dx, int dy, int dz )
+      {
+        const int nonzero = ( dx != 0 ) + ( dy != 0 ) + ( dz != 0 );
+        return std::abs( dx ) <= 1 && 0 < nonzero && nonzero <= max_nonzero;
+      };
+      my_neighbors.clear();
+      my_neighbors_after_x.clear();
+      for ( int dz = -1; dz <= 0; dz++ )
+        for ( int dy = -1; dy <= 1; dy++ )
+          for ( int dx = -1; dx <= 1; dx++ )
+            {
+              if ( dz == 0 && ( dy > 0 || ( dy == 0 && dx >= 0 ) ) ) continue;
+              if ( ! adjacent( dx, dy, dz ) ) continue;
+              const std::size_t offset
+                = std::size_t( -dx ) + std::size_t( -dy ) * my_extent.nx
+                + std::size_t( -dz ) * my_extent.nx * my_extent.ny;
+              my_neighbors.push_back( Neighbor { dx, dy, dz, offset } );
+              // The previous neighbors of x-1 are already in its tree.
+              if ( ( dx == -1 && dy == 0 && dz == 0 ) || ! adjacent( dx + 1, dy, dz ) )
+                my_neighbors_after_x.push_back( Neighbor { dx, dy, dz, offset } );
+            }
+    }
+
+    /// Calls f( j ) for the previous neighbors j of voxel (x,y,z) of
+    /// index i that lie in slices >= z0, except those already linked
+    /// through voxel x-1.
+    template < typename Function >
+    void forPreviousNeighbors( std::size_t i, std::size_t x, std::size_t y, std::size_t z,
+                               std::size_t z0, Function f ) const
+    {
+      const bool after_x = x > 0 && my_labels[ i - 1 ] != NONE;
+      for ( const auto& n : after_x ? my_neighbors_after_x : my_neighbors )
+        {
+          if ( ( n.dx < 0 && x == 0 ) || ( n.dx > 0 && x + 1 == my_extent.nx )
+               || ( n.dy < 0 && y == 0 ) || ( n.dy > 0 && y + 1 == my_extent.ny )
+               || ( n.dz < 0 && z == z0 ) )
+            continue;
+          f( i - n.offset );
+        }
+    }
+
+    /// Builds the trees of slices [z0,z1), which only this thread touches.
+    template < typename Predicate >
+    void linkSlab( const Predicate& inside, std::size_t z0, std::size_t z1 )
+    {
+      const Extent& e = my_extent;
+      for ( std::size_t z = z0; z < z1; z++ )
+        for ( std::size_t y = 0; y < e.ny; y++ )
+          for ( std::size_t x = 0, i = ( z * e.ny + y ) * e.nx; x < e.nx; x++, i++ )
+            {
+              if ( ! inside( i ) ) { my_labels[ i ] = NONE; continue; }
+              my_labels[ i ] = Label( i );
+              Label a = Label( i ); // root of the tree of i
+              forPreviousNeighbors( i, x, y, z, z0, [&] ( std::size_t j )
+              {
+                if ( my_labels[ j ] == NONE ) return;
+                const Label b = rootLocal( Label( j ) );
+                if      ( b < a ) { my_labels[ a ] = b; a = b; }
+                else if ( a < b )   my_labels[ b ] = a;
+              } );
+            }
+    }
+
+    Label rootLocal( Label i )
+    {
+      while ( my_labels[ i ] != i )
+        i = my_labels[ i ] = my_labels[ my_labels[ i ] ]; // path halving
+      return i;
+    }
+
+    /// Links slice z to slice z-1, concurrently with other faces.
+    void linkFace( std::size_t z )
+    {
+      const Extent& e = my_extent;
+      for ( std::size_t y = 0; y < e.ny; y++ )
+        for ( std::size_t x = 0, i = ( z * e.ny + y ) * e.nx; x < e.nx; x++, i++ )
+          {
+            if ( load( i ) == NONE ) continue;
+            for ( const auto& n : my_neighbors )
+              {
+                if ( n.dz == 0 || ( n.dx < 0 && x == 0 ) || ( n.dx > 0 && x + 1 == e.nx )
+                     || ( n.dy < 0 && y == 0 ) || ( n.dy > 0 && y + 1 == e.ny ) )
+                  continue;
+                const std::size_t j = i - n.offset;
+                if ( load( j ) != NONE ) unite( Label( i ), Label( j ) );
+              }
+          }
+    }
+
+    Label load( std::size_t i ) const
+    { return AtomicLabel( const_cast< Label& >( my_labels[ i ] ) ).load( std::memory_order_acquire ); }
+
+    void store( std::size_t i, Label l )
+    { AtomicLabel( my_labels[ i ] ).store( l, std::memory_order_release ); }
+
+    Label find( Label i ) const
+    {
+      for ( Label p = load( i ); p != i; p = load( i ) ) i = p;
+      return i;
+    }
+
+    /// Links the trees of i and j, the larger root pointing to the
+    /// smaller one. Another thread may link a root meanwhile, in which
+    /// case the roots are searched again.
+    void unite( Label i, Label j )
+    {
+      for ( ;; )
+        {
+          Label a = find( i ), b = find( j );
+          if ( a == b ) return;
+          if ( a < b ) std::swap( a, b );
+          Label expected = a;
+          if ( AtomicLabel( my_labels[ a ] ).compare_exchange_strong
+               ( expected, b, std::memory_order_acq_rel ) )
+            return;
+        }
+    }
+
+    /// Replaces the roots by labels in rows [r0,r1), and accumulates the
+    /// statistics of each run of voxels of the same component.
+    void labelRows( std::size_t r0, std::size_t r1 )
+    {
+      const Extent& e = my_extent;
+      for ( std::size_t r = r0; r < r1; r++ )
+        {
+          const std::size_t y = r % e.ny, z = r / e.ny;
+          Label*      row = my_labels.data() + r * e.nx;
+          Label       run = 0; // label of the current run
+          std::size_t b   = 0; // and its first voxel
+          for ( std::size_t x = 0; x <= e.nx; x++ )
+            {
+              Label l = 0;
+              if ( x < e.nx && row[ x ] != NONE )
+                {
+                  const Label p = load( r * e.nx + x );
+                  l = ( p & ROOT ) ? p & ~ROOT : load( p ) & ~ROOT;
+                }
+              if ( l == run ) continue;
+              if ( run != 0 ) addRun( run, b, x - 1, y, z );
+              run = l;
+              b   = x;
+            }
+          // Roots keep their mark until their whole row is labeled, as
+          // the voxels of other rows read it.
+          for ( std::size_t x = 0; x < e.nx; x++ )
+            {
+              const Label p = row[ x ];
+              store( r * e.nx + x, p == NONE ? 0
+                     : ( p & ROOT ) ? p & ~ROOT : load( p ) & ~ROOT );
+            }
+        }
+    }
+
+    void addRun( Label l, std::size_t x0, std::size_t x1, std::size_t y, std::size_t z )
+    {
+      Component& c = my_components[ l - 1 ];
+      AtomicSize( c.size ).fetch_add( x1 - x0 + 1, std::memory_order_relaxed );
+      const std::size_t lo[ 3 ] = { x0, y, z }, hi[ 3 ] = { x1, y, z };
+      for ( int k = 0; k < 3; k++ )
+        {
+          AtomicSize m( c.lo[ k ] ), M( c.hi[ k ] );
+          for ( std::size_t v = m.load( std::memory_order_relaxed ); lo[ k ] < v
+                  && ! m.compare_exchange_weak( v, lo[ k ], std::memory_order_relaxed ); ) ;
+          for ( std::size_t v = M.load( std::memory_order_relaxed ); hi[ k ] > v
+                  && ! M.compare_exchange_weak( v, hi[ k ], std::memory_order_relaxed ); ) ;
+        }
+    }
+
+    Extent                    my_extent { 0, 0, 0 };
+    std::vector< Neighbor >   my_neighbors; // previous neighbors for the adjacency
+    std::vector< Neighbor >   my_neighbors_after_x; // when voxel x-1 is inside
+    std::vector< Label >      my_labels;    // parent, then label, of each voxel
+    std::vector< Component >  my_components;
+  };
+} // namespace IPCV
@@ -28,6 +28,8 @@
 #include <polyscope/polyscope.h>
 #include <polyscope/surface_mesh.h>
 
+#include "common/FlatMesh.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -64,16 +66,14 @@ void createShape( std::string polynomial, double h )
   auto surfels      = SH3::getSurfelRange( surface, params );
   auto true_normals = SHG3::getNormalVectors( shape, K, surfels, params );
   
-  // Need to convert the faces
-  std::vector<std::vector<SH3::SurfaceMesh::Vertex>> faces;
-  std::vector<RealPoint> positions;
+  // Faces as a flat array of quads
+  IPCV::QuadMesh< RealPoint > mesh;
+  mesh.append( *primalSurface );
+  auto& positions = mesh.positions;
+  auto& faces     = mesh.faces;
   std::vector<RealPoint> smooth_positions;
   
-  for(auto face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  
   // Embed lattice points according to gridstep.
-  positions = primalSurface->positions();
   for ( auto& x : positions ) x *= h;
 
   // Create DGtal surface mesh object.
@@ -23,6 +23,9 @@
 #include <vector>
 #include <array>
 #include <utility>
+#include <algorithm>
+#include <cstring>
+#include <memory>
 
 #include "CLI11.hpp"
 
@@ -31,6 +34,20 @@
 #include <DGtal/helpers/Shortcuts.h>
 #include <DGtal/helpers/ShortcutsGeometry.h>
 
+#include "common/Morphology.h"
+#include "common/ThreadPool.h"
+#include "common/VolStream.h"
+#include "common/MappedVolume.h"
+#include "common/ChunkedVol.h"
+#include "common/ThresholdCache.h"
+#include "common/ImageGenerations.h"
+#include "common/SliceView.h"
+#include "common/BackgroundJob.h"
+#include "common/SurfelExtraction.h"
+#include "common/FlatMesh.h"
+#include "common/BlockRanges.h"
+#include "common/FloodFill.h"
+#include "common/VoxelComponents.h"
 
 #include "polyscope/polyscope.h"
 #include "polyscope/point_cloud.h"
@@ -48,19 +65,28 @@ typedef SurfaceMesh< Z3i::RealPoint, Z3i::RealVector >         SurfMesh;
 // Global variables
 KSpace                            K; // the space for the image
 CountedPtr< SH3::BinaryImage >    binary_image;
+IPCV::ThresholdCache< KSpace, SH3::BinaryImage > threshold_cache; // of binary_image
 CountedPtr< SH3::GrayScaleImage > current_image;
 CountedPtr< SH3::GrayScaleImage > gray_scale_image; // input image
 CountedPtr< SH3::GrayScaleImage > lung_image;       // segmented lungs
 CountedPtr< SH3::GrayScaleImage > output_image;     // output vascular system
-CountedPtr< SH3::LightDigitalSurface > main_surface;
-SH3::SurfelRange all_surfels;
+CountedPtr< SH3::DigitalSurface > main_surface;         // largest component
+std::vector< CountedPtr< SH3::DigitalSurface > > big_surfaces; // components >= minimum_size
+SH3::SurfelRange all_surfels;                           // their surfels
+IPCV::BoundaryComponents< KSpace > boundary; // extracted in parallel by slabs
+IPCV::BlockRanges block_ranges; // min/max of the blocks of the last thresholded image
+IPCV::VoxelComponents voxel_components; // of binary_image
+IPCV::ImageGenerations generations; // of the gray-scale images, keys of the caches
 Parameters params;
+IPCV::ThreadPool thread_pool; // threads used by image filters
+IPCV::MorphologyEngine morphology( thread_pool ); // in place filters
+IPCV::BackgroundWorker worker; // runs the long GUI actions
 
 // Global variables for GUI
 int threshold = 128;
-polyscope::SurfaceMesh* sliceXSurf;
-polyscope::SurfaceMesh* sliceYSurf;
-polyscope::SurfaceMesh* sliceZSurf;
+IPCV::SliceView sliceXView; // slices are built once, then only
+IPCV::SliceView sliceYView; // moved and recolored
+IPCV::SliceView sliceZView;
 int lx = -1;
 int ly = -1;
 int lz = -1;
@@ -75,205 +101,435 @@ int last_img_choice = 1;
 int      img_choice = 0;
 int  closing_radius = 5;
 int    minimum_size = 1000;
+int  lung_threshold = 80; // only used by the batch pipeline
+bool    parity_fill = false; // fillSurface toggles sides along rows instead of flooding
+int voxel_adjacency = 26;    // of the voxel components
 
-polyscope::SurfaceMesh*
-buildInitialSlice( std::string name, Point lo, Point up, int axis )
+/// @return a new image of domain \a D, filled with 0, with a new generation.
+CountedPtr< SH3::GrayScaleImage > makeImage( const Domain& D )
 {
-  Point slo = lo;
-  Point sup = up;
-  sup[ axis ] = lo[ axis ];
-  Point s = sup - slo + Point::diagonal(1);
-  Point t = s + Point::diagonal(1);
-  const int nb_faces    = s[ 0 ] * s[ 1 ] * s[ 2 ];
-  const int nb_vertices = t[ 0 ] * t[ 1 ] * t[ 2 ];
-  std::vector<RealPoint> positions( nb_vertices, RealPoint::zero );
-  int i = ( axis == 0 ) ? 1 : 0; // first axis
-  int j = ( axis == 2 ) ? 1 : 2; // second axis
-  int idx = 0;
-  RealPoint current;
-  current[ axis ] = lo[ axis ] + 0.5;
-  for ( int y = lo[ j ]; y <= up[ j ] + 1; y++ )
+  CountedPtr< SH3::GrayScaleImage > image = SH3::makeGrayScaleImage( D );
+  generations.touch( image->data() );
+  return image;
+}
+
+/// @return the image whose interior voxels of the given surfels
+/// have value 255, others 0. If \a inverse is true, the exterior is
+/// filled instead. If parity_fill is true, the surfaces must be closed.
+/// If \a stop is raised meanwhile, the image is only partially filled.
+CountedPtr< SH3::GrayScaleImage >
+fillSurface( const SH3::SurfelRange& surfels,
+             bool inverse, const IPCV::StopFlag* stop = nullptr )
+{
+  Point lo = K.lowerBound();
+  Point up = K.upperBound();
+  Domain D( lo, up );
+  // The image is filled with zero at the beginning
+  CountedPtr< SH3::GrayScaleImage > output = makeImage( D );
+  SH3::GrayScaleImage& img = *output;
+  // Outer voxels are set to 1 and inner voxels to 255, which makes a
+  // wall that the filling cannot cross.
+  const auto e = IPCV::extent( img );
+  std::vector< std::size_t > seeds;
+  std::vector< IPCV::RowCrossing > crossings; // surfels orthogonal to x
+  auto index = [&] ( const Point& p )
+  {
+    const Point q = p - lo;
+    return ( std::size_t( q[ 2 ] ) * e.ny + std::size_t( q[ 1 ] ) ) * e.nx + std::size_t( q[ 0 ] );
+  };
+  for ( auto s : surfels )
+    {
+      auto k     = K.sOrthDir( s );
+      auto ext_p = K.sCoords( inverse
+                              ? K.sDirectIncident( s, k )
+                              : K.sIndirectIncident( s, k ) );
+      if ( D.isInside( ext_p ) ) img.setValue( ext_p, 1 );
+    }
+  for ( auto s : surfels )
     {
-      current[ j ] = y;
-      for ( int x = lo[ i ]; x <= up[ i ] + 1; x++ )
+      auto k     = K.sOrthDir( s );
+      auto int_p = K.sCoords( inverse
+                              ? K.sIndirectIncident( s, k )
+                              : K.sDirectIncident( s, k ) );
+      if ( D.isInside( int_p ) && img( int_p ) != 255 )
+        {
+          img.setValue( int_p, 255 );
+          seeds.push_back( index( int_p ) );
+        }
+      if ( parity_fill && k == 0 )
         {
-          current[ i ] = x;
-          positions[ idx++ ] = current;
+          auto ext_p = K.sCoords( inverse
+                                  ? K.sDirectIncident( s, k )
+                                  : K.sIndirectIncident( s, k ) );
+          if ( D.isInside( int_p ) && D.isInside( ext_p ) )
+            {
+              const bool        fill_right = ext_p[ 0 ] < int_p[ 0 ];
+              const std::size_t left       = index( fill_right ? ext_p : int_p );
+              crossings.push_back( { left - left % e.nx, left % e.nx, fill_right } );
+            }
         }
     }
-  idx = 0;
-  std::vector<std::vector<size_t>> faces( nb_faces );
-  for ( size_t y = lo[ j ]; y <= up[ j ]; y++ )
-    for ( size_t x = lo[ i ]; x <= up[ i ]; x++ )
-      faces[ idx++ ] = std::vector<size_t>( {
-          t[ i ] * y + x,
-          t[ i ] * y + x + 1,
-          t[ i ] * ( y + 1 ) + x + 1,
-          t[ i ] * ( y + 1 ) + x
-        } );
-  return polyscope::registerSurfaceMesh( name, positions, faces);
+  if ( parity_fill ) // toggles sides along rows, and removes the wall
+    IPCV::parityFill( img.data(), e, std::move( crossings ), thread_pool, stop );
+  else
+    {
+      // Filling along 6-neighbors, by spans of rows
+      IPCV::floodFill( img.data(), e, seeds, thread_pool, stop );
+      // Removes the wall
+      for ( auto& v : img ) if ( v == 1 ) v = 0;
+    }
+  return output;
 }
-  
-void
-updateSlice( CountedPtr<SH3::GrayScaleImage> image,
-             polyscope::SurfaceMesh* smesh, Point lo, Point up,
-             int axis, int pos )
+
+/// Sets binary_image to the voxels of \a image above \a t.
+void thresholdImage( CountedPtr<SH3::GrayScaleImage> image, int t )
 {
-  Point slo = lo;
-  Point sup = up;
-  sup[ axis ] = pos;
-  slo[ axis ] = pos;
-  Point s = sup - slo + Point::diagonal(1);
-  Point t = s + Point::diagonal(1);
-  const int nb_faces    = s[ 0 ] * s[ 1 ] * s[ 2 ];
-  const int nb_vertices = t[ 0 ] * t[ 1 ] * t[ 2 ];
-  std::vector<RealPoint> positions( nb_vertices );
-  int i = ( axis == 0 ) ? 1 : 0; // first axis
-  int j = ( axis == 2 ) ? 1 : 2; // second axis
-  int idx = 0;
-  RealPoint current;
-  current[ axis ] = pos + 0.5;
-  for ( int y = lo[ j ]; y <= up[ j ] + 1; y++ )
+  // Builds a thresholded image from a gray scale image
+  // (values are read in storage order, without point linearization).
+  // Re-thresholding the same image only flips the voxels between the
+  // previous and the new threshold.
+  const auto generation = generations( image->data() );
+  if ( binary_image.get() == nullptr || ! threshold_cache.isValid( generation ) )
     {
-      current[ j ] = y;
-      for ( int x = lo[ i ]; x <= up[ i ] + 1; x++ )
-        {
-          current[ i ] = x;
-          positions[ idx++ ] = current;
-        }
+      binary_image  = CountedPtr<SH3::BinaryImage>( new SH3::BinaryImage( image->domain() ) );
+      std::transform( image->begin(), image->end(), binary_image->begin(),
+                      [t] ( unsigned char v ) { return int( v ) > t; } );
+      threshold_cache.init( K, image->data(), generation, *binary_image, t, false );
+    }
+  else
+    threshold_cache.setThreshold( t );
+}
+
+/// Extracts the connected components of the boundary of the voxels of
+/// \a image above \a t, and sorts them by decreasing size. Sets
+/// main_surface to the largest one, and big_surfaces/all_surfels to
+/// those with at least minimum_size surfels.
+/// @return 'false' if \a stop was raised meanwhile, these surfaces
+/// being then left unchanged.
+bool extractDigitalSurfaces( CountedPtr<SH3::GrayScaleImage> image, int t,
+                             const IPCV::StopFlag* stop = nullptr )
+{
+  trace.beginBlock( "Extracting digital surfaces" );
+  thresholdImage( image, t );
+  // Only the blocks straddling t may contain boundary surfels.
+  const auto generation = generations( image->data() );
+  if ( ! block_ranges.isValid( generation ) )
+    block_ranges.init( image->data(), IPCV::extent( *image ), generation, thread_pool );
+  else
+    block_ranges.update( thread_pool ); // blocks modified by the filters
+  const auto blocks = block_ranges.activeBlocks( t );
+  SurfelAdjacency< 3 > surfAdj( params[ "surfelAdjacency" ].as<int>() );
+  // Components smaller than minimum_size (but the largest) are dropped
+  // as soon as their size is known.
+  boundary.init( K, surfAdj, *binary_image, thread_pool, &blocks,
+                 std::size_t( std::max( minimum_size, 0 ) ), stop );
+  if ( IPCV::isStopped( stop ) )
+    {
+      trace.info() << "Cancelled" << std::endl;
+      trace.endBlock();
+      return false;
+    }
+  const auto& components = boundary.components(); // largest first
+  auto makeSurface = [&] ( const std::vector< SH3::SCell >& surfels )
+  {
+    return CountedPtr< SH3::DigitalSurface >
+    ( new SH3::DigitalSurface
+      ( new SH3::ExplicitSurfaceContainer
+        ( K, surfAdj, SH3::SurfelSet( surfels.begin(), surfels.end() ) ) ) );
+  };
+  main_surface = components.empty()
+    ? CountedPtr< SH3::DigitalSurface >() : makeSurface( components[ 0 ] );
+  big_surfaces.clear();
+  all_surfels.clear();
+  for ( const auto& surfels : components )
+    {
+      if ( surfels.size() < std::size_t( minimum_size ) ) break;
+      big_surfaces.push_back( big_surfaces.empty() ? main_surface : makeSurface( surfels ) );
+      all_surfels.insert( all_surfels.end(), surfels.begin(), surfels.end() );
     }
-  std::vector< double > colors( nb_faces );
-  Domain D( slo, sup );
-  idx = 0;
-  for ( auto p : D )
-    colors[ idx++ ] = (*image)(p);
-  smesh->updateVertexPositions( positions );
-  smesh->addFaceScalarQuantity( "image intensities", colors )
-    ->setMapRange( { 0.0, 255.0 } )
-    ->setEnabled( true );
+  trace.info() << boundary.nbComponents() << " components, "
+               << big_surfaces.size() << " of size >= " << minimum_size << std::endl;
+  trace.endBlock();
+  return true;
 }
 
+/// @return the image whose voxels of \a image above \a t that belong
+/// to voxel components (for voxel_adjacency) of at least minimum_size
+/// voxels have value 255, others 0. No surface is extracted.
 CountedPtr< SH3::GrayScaleImage >
-fillSurface( const SH3::SurfelRange& surfels,
-             bool inverse )
+selectVoxelComponents( CountedPtr<SH3::GrayScaleImage> image, int t )
 {
-  Point lo = K.lowerBound();
-  Point up = K.upperBound();
-  Domain D( lo, up );
-  // The image is filled with zero at the beginning
-  CountedPtr< SH3::GrayScaleImage > output = SH3::makeGrayScaleImage( D );
-  // TODO
-  // ...
+  trace.beginBlock( "Selecting voxel components" );
+  thresholdImage( image, t );
+  voxel_components.init( *binary_image, voxel_adjacency, thread_pool );
+  CountedPtr< SH3::GrayScaleImage > output = makeImage( image->domain() );
+  voxel_components.select( output->data(), std::size_t( minimum_size ), thread_pool );
+  trace.info() << voxel_components.size() << " components" << std::endl;
+  trace.endBlock();
   return output;
 }
 
-void extractDigitalSurface( CountedPtr<SH3::GrayScaleImage> image,
-                            int t, std::string label )
+/// The vertices and faces of a mesh, built by a background job and
+/// registered in polyscope by the GUI thread.
+typedef IPCV::QuadMesh< RealPoint > MeshData;
+
+/// Builds the mesh of the big components as one surface, reporting
+/// progress from 0.5 to 1 to \a job.
+/// @return 'false' if \a job was cancelled meanwhile.
+bool makeDigitalSurfacesMesh( MeshData& mesh, IPCV::JobControl& job )
 {
-  trace.beginBlock( "Extracting digital surface" );
-  // Builds a thresholded image from a gray scale image
-  Domain domain = image->domain();
-  binary_image  = CountedPtr<SH3::BinaryImage>( new SH3::BinaryImage( domain ) );
-  std::transform( domain.begin(), domain.end(),
-                  binary_image->begin(),
-                  [&] ( const Point& p ) { return (*image)(p) > t; } );
-  auto surface = SH3::makeDigitalSurface( binary_image, K, params );
-  trace.endBlock();
-  trace.beginBlock( "Make primal surface" );
-  auto primalSurface = SH3::makePrimalSurfaceMesh( surface );
+  trace.beginBlock( "Make primal surfaces" );
+  for ( std::size_t i = 0; i < big_surfaces.size() && ! job.isCancelled(); i++ )
+    {
+      auto primalSurface = SH3::makePrimalSurfaceMesh( big_surfaces[ i ] );
+      mesh.append( *primalSurface );
+      job.setProgress( 0.5 + 0.5 * double( i + 1 ) / double( big_surfaces.size() ) );
+    }
   trace.endBlock();
-  // Builds a polyscope surface from a pointer on a dgtal SurfaceMesh.
-  trace.beginBlock( "Register surface in polyscope" );
-  std::vector<std::vector<size_t>> faces;
-  // Need to convert the faces
-  for( size_t face= 0 ; face < primalSurface->nbFaces(); ++face )
-    faces.push_back( primalSurface->incidentVertices( face ) );
-  std::vector<RealPoint> positions = primalSurface->positions();
-  auto primalSurf = polyscope::registerSurfaceMesh
-    ( "Digital surface " + label, positions, faces);
+  return ! job.isCancelled();
+}
+
+/// To be called once \a image has been modified in place: its new
+/// generation invalidates its thresholded image, and its block ranges
+/// must be recomputed. If \a radius is not negative, the image was
+/// modified by min/max filters of this total radius (e.g. 2r for a
+/// closing of radius r), and only the blocks near non-constant blocks
+/// are recomputed.
+void imageModified( CountedPtr<SH3::GrayScaleImage> image, int radius = -1 )
+{
+  const auto previous   = generations( image->data() );
+  const auto generation = generations.touch( image->data() );
+  if ( ! block_ranges.isValid( previous ) ) return;
+  if ( radius >= 0 ) block_ranges.invalidateFiltered( std::size_t( radius ), generation );
+  else               block_ranges.invalidate( generation );
+}
+
+/// Closes the lung mask with closing_radius, then keeps the input
+/// image only inside the mask. If \a stop is raised meanwhile, the
+/// mask is left partially closed.
+void selectLungs( const IPCV::StopFlag* stop = nullptr )
+{
+  trace.beginBlock( "Select lungs" );
+  morphology.close( *lung_image, closing_radius, stop );
+  if ( IPCV::isStopped( stop ) )
+    imageModified( lung_image, 2 * closing_radius );
+  else
+    {
+      std::transform( lung_image->begin(), lung_image->end(),
+                      gray_scale_image->begin(), lung_image->begin(),
+                      [] ( unsigned char mask, unsigned char value )
+                      { return mask == 255 ? value : (unsigned char) 0; } );
+      imageModified( lung_image );
+    }
   trace.endBlock();
-  // The surface may be disconnected for now
 }
 
-CountedPtr<SH3::GrayScaleImage>
-makeDilation( CountedPtr<SH3::GrayScaleImage> image_ptr )
+/// To be called once an in-place filter of total radius \a radius has
+/// modified current_image, even if \a job stopped it halfway.
+/// @return 'true', since the image must be displayed again anyway.
+bool filtered( IPCV::JobControl& job, int radius )
 {
-  const SH3::GrayScaleImage& image = *image_ptr;
-  // Clone image
-  CountedPtr<SH3::GrayScaleImage> output_ptr
-    = CountedPtr<SH3::GrayScaleImage>( new SH3::GrayScaleImage( image ) );
-  Domain D = image.domain();
-  Point lo = D.lowerBound();
-  Point up = D.upperBound();
-  // TODO
-  // ...
-  return output_ptr;
+  imageModified( current_image, radius );
+  if ( job.isCancelled() )
+    trace.warning() << "Cancelled: the image is only partially filtered" << std::endl;
+  return true;
 }
 
-CountedPtr<SH3::GrayScaleImage>
-makeErosion( CountedPtr<SH3::GrayScaleImage> image_ptr )
+/// Runs the whole segmentation without GUI: lungs are the exterior
+/// of the main surface at lung_threshold, vessels are the interior
+/// of the big surfaces at threshold within the lungs.
+bool runPipeline( std::string output_filename )
 {
-  const SH3::GrayScaleImage& image = *image_ptr;
-  // Clone image
-  CountedPtr<SH3::GrayScaleImage> output_ptr
-    = CountedPtr<SH3::GrayScaleImage>( new SH3::GrayScaleImage( image ) );
-  Domain D = image.domain();
-  Point lo = D.lowerBound();
-  Point up = D.upperBound();
-  // TODO
-  // ...
-  return output_ptr;
+  trace.beginBlock( "Segmentation pipeline" );
+  extractDigitalSurfaces( gray_scale_image, lung_threshold );
+  if ( main_surface.get() == nullptr )
+    {
+      trace.error() << "No surface at threshold " << lung_threshold << std::endl;
+      trace.endBlock();
+      return false;
+    }
+  lung_image = fillSurface( SH3::getSurfelRange( main_surface, params ), true );
+  selectLungs();
+  extractDigitalSurfaces( lung_image, threshold );
+  output_image = fillSurface( all_surfels, false );
+  trace.info() << "Saving <" << output_filename << "> image" << std::endl;
+  bool ok = IPCV::saveChunkedVol( output_image->data(), IPCV::extent( *output_image ),
+                                   output_filename, thread_pool );
+  trace.endBlock();
+  return ok;
+}
+
+/// Thresholds (if t >= 0) then closes with closing_radius the image
+/// in \a input_filename, and writes the result in \a output_filename.
+/// The image is streamed by slabs of \a slab z-slices, with a halo of
+/// 2*closing_radius slices on each side (dilation then erosion), so
+/// that the memory used does not depend on the image depth.
+bool streamFilter( std::string input_filename, std::string output_filename,
+                   int t, std::size_t slab )
+{
+  IPCV::VolSliceReader reader;
+  IPCV::VolSliceWriter writer;
+  if ( ! reader.open( input_filename ) )
+    {
+      trace.error() << "Unable to read <" << input_filename << ">" << std::endl;
+      return false;
+    }
+  IPCV::VolHeader header = reader.header();
+  header.version = 3;
+  if ( ! writer.open( output_filename, header ) )
+    {
+      trace.error() << "Unable to write <" << output_filename << ">" << std::endl;
+      return false;
+    }
+  trace.beginBlock( "Streaming filter" );
+  slab = std::max( slab, std::size_t( 1 ) );
+  const std::size_t S    = header.sliceSize();
+  const std::size_t nz   = header.nz;
+  const std::size_t halo = 2 * std::max( closing_radius, 0 );
+  std::vector< unsigned char > window( ( slab + 2 * halo ) * S );
+  std::vector< unsigned char > work( window.size() );
+  IPCV::Extent e { header.nx, header.ny, slab + 2 * halo };
+  morphology.setup( e, closing_radius );
+  std::size_t wlo = 0; // slices [wlo,whi) are in window
+  std::size_t whi = 0;
+  bool ok = true;
+  for ( std::size_t z0 = 0; ok && z0 < nz; z0 += slab )
+    {
+      const std::size_t z1 = std::min( nz, z0 + slab );
+      const std::size_t lo = z0 < halo ? 0 : z0 - halo;
+      const std::size_t hi = std::min( nz, z1 + halo );
+      // Keeps the slices of the previous window that are still needed.
+      std::memmove( window.data(), window.data() + ( lo - wlo ) * S, ( whi - lo ) * S );
+      unsigned char* fresh = window.data() + ( whi - lo ) * S;
+      const std::size_t nb = reader.read( fresh, hi - whi );
+      if ( nb != hi - whi )
+        {
+          trace.error() << "Truncated file <" << input_filename << ">" << std::endl;
+          ok = false;
+          break;
+        }
+      if ( t >= 0 )
+        std::transform( fresh, fresh + nb * S, fresh,
+                        [t] ( unsigned char v ) { return v > t ? 255 : 0; } );
+      wlo  = lo;
+      whi  = hi;
+      e.nz = whi - wlo;
+      std::copy( window.begin(), window.begin() + e.size(), work.begin() );
+      morphology.close( work.data(), e, closing_radius );
+      ok = writer.write( work.data() + ( z0 - wlo ) * S, z1 - z0 );
+      trace.progressBar( z1, nz );
+    }
+  ok = writer.close() && ok;
+  trace.endBlock();
+  return ok;
 }
 
 // Polyscope GUI Callback
 void mycallback()
 {
+  // Long actions run in the background: meanwhile, the images belong
+  // to the job and only its status is displayed.
+  if ( IPCV::jobStatus( worker ) ) return;
   ImGui::SliderInt("Closing radius", &closing_radius, 0, 15 ); //, "ratio = %.3f");
   Point lo = K.lowerBound();
   Point up = K.upperBound();
+  auto refreshSlices = [] { refresh = true; };
+  // Filters work in place on the current image, without any allocation.
+  // Cancelled, they stop at the next slice, and the partially filtered
+  // image is displayed.
   if ( ImGui::Button( "Dilation" ) )
+    worker.start( "Dilation", [] ( IPCV::JobControl& job )
     {
-      *current_image = *makeDilation( current_image );
-      refresh = true;
-    }
+      morphology.dilate( *current_image, 1, job.stopFlag() );
+      return filtered( job, 1 );
+    }, refreshSlices );
   ImGui::SameLine();
   if ( ImGui::Button( "Erosion" ) )
+    worker.start( "Erosion", [] ( IPCV::JobControl& job )
     {
-      *current_image = *makeErosion( current_image );
-      refresh = true;
-    }
+      morphology.erode( *current_image, 1, job.stopFlag() );
+      return filtered( job, 1 );
+    }, refreshSlices );
+  ImGui::SameLine();
+  if ( ImGui::Button( "Closing" ) )
+    worker.start( "Closing", [r = closing_radius] ( IPCV::JobControl& job )
+    {
+      trace.beginBlock( "Closing" );
+      morphology.dilate( *current_image, r, job.stopFlag() );
+      job.setProgress( 0.5 );
+      morphology.erode( *current_image, r, job.stopFlag() );
+      trace.endBlock();
+      return filtered( job, 2 * r );
+    }, refreshSlices );
   ImGui::SameLine();
   if ( ImGui::Button( "Save" ) )
+    worker.start( "Saving <output.vol>", [] ( IPCV::JobControl& job )
     {
-      std::cout << "Saving <output.vol> image... ";
-      bool ok = SH3::saveGrayScaleImage( current_image, "output.vol" );
-      std::cout << ( ok ? "ok." : "error." ) << std::endl;
-    }
+      bool ok = IPCV::saveChunkedVol( current_image->data(), IPCV::extent( *current_image ),
+                                       "output.vol", thread_pool, 16, Z_DEFAULT_COMPRESSION,
+                                       job.stopFlag() );
+      std::cout << "Saving <output.vol> image... "
+                << ( job.isCancelled() ? "cancelled." : ok ? "ok." : "error." ) << std::endl;
+      return ok;
+    } );
 
   ImGui::SliderInt("Threshold", &threshold, 0, 255 ); //, "ratio = %.3f");
   ImGui::SliderInt("Minimum size", &minimum_size, 0, 10000 );
   if (ImGui::Button("Digital surface"))
     {
-      extractDigitalSurface( current_image, threshold, "" );
+      auto mesh = std::make_shared< MeshData >();
+      worker.start( "Extracting digital surfaces",
+                    [mesh, t = threshold] ( IPCV::JobControl& job )
+                    {
+                      if ( ! extractDigitalSurfaces( current_image, t, job.stopFlag() ) )
+                        return false;
+                      job.setProgress( 0.5 );
+                      return ! job.isCancelled() && makeDigitalSurfacesMesh( *mesh, job );
+                    },
+                    [mesh] // registration must be done by the GUI thread
+                    {
+                      trace.beginBlock( "Register surface in polyscope" );
+                      polyscope::registerSurfaceMesh( "Digital surface ", mesh->positions, mesh->faces );
+                      trace.endBlock();
+                    } );
     }
   ImGui::SameLine();
-  if (ImGui::Button("Fill main surf."))
+  if (ImGui::Button("Fill main surf.") && main_surface.get() != nullptr )
+    worker.start( "Filling main surface", [] ( IPCV::JobControl& job )
     {
-      // TODO
-      refresh = true;
-    }
+      auto image = fillSurface( SH3::getSurfelRange( main_surface, params ), true,
+                                job.stopFlag() );
+      if ( job.isCancelled() ) return false; // lung_image is unchanged
+      lung_image = image;
+      return true;
+    }, refreshSlices );
   ImGui::SameLine();
   if (ImGui::Button("Select lungs"))
+    worker.start( "Selecting lungs", [] ( IPCV::JobControl& job )
     {
-      // TODO
-      refresh = true;
-    }
+      selectLungs( job.stopFlag() );
+      return true; // the lung image was modified, even if cancelled
+    }, refreshSlices );
   ImGui::SameLine();
   if (ImGui::Button("Fill all surf."))
+    worker.start( "Filling all surfaces", [] ( IPCV::JobControl& job )
     {
-      // TODO
-      refresh = true;
-    }
+      auto image = fillSurface( all_surfels, false, job.stopFlag() );
+      if ( job.isCancelled() ) return false; // output_image is unchanged
+      output_image = image;
+      return true;
+    }, refreshSlices );
+  ImGui::SameLine();
+  ImGui::Checkbox("Parity fill", &parity_fill);
+  if (ImGui::Button("Big voxel comp."))
+    worker.start( "Selecting voxel components", [t = threshold] ( IPCV::JobControl& job )
+    {
+      auto image = selectVoxelComponents( current_image, t );
+      if ( job.isCancelled() ) return false; // output_image is unchanged
+      output_image = image;
+      return true;
+    }, refreshSlices );
+  if ( worker.busy() ) return; // the job has just started
   
   ImGui::RadioButton("Input image",  &img_choice, 0); ImGui::SameLine();
   ImGui::RadioButton("Lung image",   &img_choice, 1); ImGui::SameLine();
@@ -294,43 +550,70 @@ void mycallback()
   ImGui::SameLine();
   ImGui::Checkbox("Slice Z", &slice_z);
   if ( refresh || ( slice_x && (lx != x) ) )
-    updateSlice( current_image, sliceXSurf, lo, up, 0, x );
+    sliceXView.update( current_image->data(), x - lo[ 0 ] );
   if ( refresh || ( slice_y && (ly != y) ) )
-    updateSlice( current_image, sliceYSurf, lo, up, 1, y );
+    sliceYView.update( current_image->data(), y - lo[ 1 ] );
   if ( refresh || ( slice_z && (lz != z) ) )
-    updateSlice( current_image, sliceZSurf, lo, up, 2, z );
+    sliceZView.update( current_image->data(), z - lo[ 2 ] );
   lx = x;
   ly = y;
   lz = z;
-  sliceXSurf->setEnabled( slice_x );
-  sliceYSurf->setEnabled( slice_y );
-  sliceZSurf->setEnabled( slice_z );
+  sliceXView.mesh()->setEnabled( slice_x );
+  sliceYView.mesh()->setEnabled( slice_y );
+  sliceZView.mesh()->setEnabled( slice_z );
   refresh = false;
 }
 
 // main program
 int main( int argc, char* argv[] )
 {
-  polyscope::init();
-  
   CLI::App app{"Filtering practical"};
   std::string filename;
+  std::string output_filename = "output.vol";
+  int nb_threads = 0;
+  bool batch     = false;
+  bool stream    = false;
+  int  slab      = 32;
+  bool companion = false;
   app.add_option("-i,--input,1", filename, "Input VOL file")->required()->check(CLI::ExistingFile);
+  app.add_option("-j,--threads", nb_threads, "Number of threads for image filters (0 means all hardware threads)")->check(CLI::NonNegativeNumber);
+  app.add_flag("--mvol", companion, "Writes the uncompressed .mvol companion of the input VOL file, which is loaded instead next time");
+  app.add_flag("--batch", batch, "Runs the whole segmentation without GUI and saves the output image");
+  app.add_flag("--stream", stream, "Thresholds (-t, negative to skip) then closes (-r) the input slab by slab, without loading it, and saves the output image");
+  app.add_option("--slab", slab, "Number of z-slices per slab in stream mode")->capture_default_str();
+  app.add_option("-o,--output", output_filename, "Output VOL file in batch or stream mode")->capture_default_str();
+  app.add_option("-t,--threshold", threshold, "Threshold of the vascular system")->capture_default_str();
+  app.add_option("--lung-threshold", lung_threshold, "Threshold of the main surface (lungs) in batch mode")->capture_default_str();
+  app.add_option("-r,--closing-radius", closing_radius, "Radius of the closing of the lungs")->capture_default_str();
+  app.add_option("-m,--minimum-size", minimum_size, "Minimum number of surfels of kept components")->capture_default_str();
+  app.add_option("--voxel-adjacency", voxel_adjacency, "Adjacency (6, 18 or 26) of the voxel components")->check(CLI::IsMember({6, 18, 26}))->capture_default_str();
+  app.add_flag("--parity", parity_fill, "Fills the closed surfaces by toggling inside/outside along rows instead of flooding");
   CLI11_PARSE(app,argc,argv);
+  thread_pool.resize( nb_threads );
+  trace.info() << "Image filters: " << thread_pool.size() << " thread(s), "
+               << IPCV::kernels::rowKernels().name << " kernels" << std::endl;
+  if ( stream )
+    return streamFilter( filename, output_filename, threshold, slab ) ? 0 : 1;
   
-  // Read voxel object and hands everything to polyscope
+  // Read voxel object
   params = SH3::defaultParameters()| SHG3::defaultParameters() | SHG3::parametersGeometryEstimation();
   params( "closed", 1)("surfaceComponents", "All")("surfelAdjacency", 1);
-  gray_scale_image  = SH3::makeGrayScaleImage( filename );
+  gray_scale_image  = IPCV::loadGrayScaleImage< SH3 >( filename, companion );
+  generations.touch( gray_scale_image->data() );
   lung_image        = gray_scale_image;
   output_image      = gray_scale_image;
   K = SH3::getKSpace( gray_scale_image );
-  
+  morphology.setup( IPCV::extent( *gray_scale_image ), 15 ); // max closing radius
+  if ( batch )
+    return runPipeline( output_filename ) ? 0 : 1;
+
+  // Hands everything to polyscope
+  polyscope::init();
   Point lo = K.lowerBound();
-  Point up = K.upperBound();
-  sliceXSurf = buildInitialSlice( "Slice X", lo, up, 0 );
-  sliceYSurf = buildInitialSlice( "Slice Y", lo, up, 1 );
-  sliceZSurf = buildInitialSlice( "Slice Z", lo, up, 2 );
+  const IPCV::Extent e = IPCV::extent( *gray_scale_image );
+  sliceXView.init( "Slice X", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 0 );
+  sliceYView.init( "Slice Y", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 1 );
+  sliceZView.init( "Slice Z", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 2 );
   // Give the hand to polyscope
   polyscope::state::userCallback = mycallback;
   polyscope::show();
@@ -0,0 +1,86 @@
+/**
+ *  This program is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU Lesser General Public License as
+ *  published by the Free Software Foundation, either version 3 of the
+ *  License, or  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+/**
+ * @file check-thinning.cpp
+ * @author Jacques-Olivier Lachaud (\c jacques-olivier.lachaud@univ-savoie.fr )
+ * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
+ * @date 2026/10/16
+ *
+ * Checks the bit packing of HomotopicThinning on random objects whose
+ * padded rows end at, or just before, a word boundary (widths 61, 62,
+ * 125, 126, ...): every voxel and every configuration read by the
+ * thinning must match the ones computed directly from the object.
+ * Best run under AddressSanitizer. Returns 1 on the first mismatch.
+ */
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "common/HomotopicThinning.h"
+
+/// A table where no point is simple, so that the object never changes.
+struct NoSimplePoint
+{
+  bool operator[]( std::uint32_t ) const { return false; }
+};
+
+int main()
+{
+  std::mt19937 rng( 1 );
+  NoSimplePoint table;
+  for ( std::size_t nx : { 1, 2, 3, 60, 61, 62, 63, 64, 124, 125, 126, 127, 128, 189, 190 } )
+    for ( int trial = 0; trial < 2; trial++ )
+      {
+        const IPCV::Extent e { nx, 3 + rng() % 4, 3 + rng() % 6 };
+        std::vector< unsigned char > object( e.size() );
+        for ( auto& v : object ) v = rng() % 3 != 0;
+        auto isObject = [&] ( long x, long y, long z )
+        {
+          return 0 <= x && x < long( e.nx ) && 0 <= y && y < long( e.ny )
+            && 0 <= z && z < long( e.nz ) && object[ ( z * e.ny + y ) * e.nx + x ];
+        };
+        IPCV::HomotopicThinning< NoSimplePoint > thinning;
+        thinning.init( [&] ( std::size_t i ) { return object[ i ] != 0; }, e, table );
+        std::size_t nb_wrong = 0;
+        for ( std::size_t z = 0; z < e.nz; z++ )
+          for ( std::size_t y = 0; y < e.ny; y++ )
+            for ( std::size_t x = 0; x < e.nx; x++ )
+              nb_wrong += thinning.isInside( x, y, z ) != isObject( x, y, z );
+        // The anchor sees the configuration of every border voxel.
+        thinning.orderedThinning( [] ( std::size_t ) { return 0u; },
+                                  [&] ( std::size_t i, std::uint32_t c )
+        {
+          const long x = long( i % e.nx ), y = long( i / e.nx % e.ny ), z = long( i / e.nx / e.ny );
+          std::uint32_t expected = 0;
+          for ( int dz = -1; dz <= 1; dz++ )
+            for ( int dy = -1; dy <= 1; dy++ )
+              for ( int dx = -1; dx <= 1; dx++ )
+                if ( ( dx != 0 || dy != 0 || dz != 0 ) && isObject( x + dx, y + dy, z + dz ) )
+                  expected |= std::uint32_t( 1 ) << IPCV::neighborhoodBit( dx, dy, dz );
+          nb_wrong += c != expected;
+          return false;
+        } );
+        if ( nb_wrong != 0 )
+          {
+            std::cout << "Extent " << e.nx << "x" << e.ny << "x" << e.nz
+                      << ": " << nb_wrong << " wrong voxels or configurations" << std::endl;
+            return 1;
+          }
+      }
+  std::cout << "Bit packing of HomotopicThinning... ok." << std::endl;
+  return 0;
+}
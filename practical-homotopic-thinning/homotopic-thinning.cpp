@@ -22,6 +22,8 @@
  * Laboratory of Mathematics (CNRS, UMR 5127), University of Savoie, France
  * @date 2025/12/04
  */
+#include <bit>
+#include <cstdint>
 #include <iostream>
 #include <vector>
 #include <array>
@@ -34,6 +36,8 @@
 #include <DGtal/helpers/Shortcuts.h>
 #include <DGtal/helpers/ShortcutsGeometry.h>
 #include <DGtal/shapes/SurfaceMesh.h>
+#include <DGtal/images/SimpleThresholdForegroundPredicate.h>
+#include <DGtal/geometry/volumes/distance/DistanceTransformation.h>
 #include <DGtal/topology/NeighborhoodConfigurations.h>
 #include <DGtal/topology/tables/NeighborhoodTables.h>
 
@@ -42,6 +46,10 @@
 #include "polyscope/point_cloud.h"
 #include "polyscope/surface_mesh.h"
 
+#include "common/FlatMesh.h"
+#include "common/HomotopicThinning.h"
+#include "common/ThreadPool.h"
+
 
 using namespace DGtal;
 using namespace Z3i;
@@ -50,10 +58,18 @@ using namespace Z3i;
 typedef Shortcuts<Z3i::KSpace>         SH3;
 typedef ShortcutsGeometry<Z3i::KSpace> SHG3;
 typedef SurfaceMesh< Z3i::RealPoint, Z3i::RealVector >         SurfMesh;
+typedef functors::SimpleThresholdForegroundPredicate<SH3::BinaryImage> Predicate;
+typedef DistanceTransformation< Z3i::Space, Predicate, Z3i::L2Metric> DT;
 
 
 CountedPtr< SH3::BinaryImage > binary_image;
+CountedPtr< SH3::BinaryImage > thinned_image; // voxels of the_object
 CountedPtr< Z3i::Object26_6 >  the_object;
+CountedPtr< boost::dynamic_bitset<> > simple_table; // tableSimple26_6
+IPCV::HomotopicThinning< boost::dynamic_bitset<> > thinning; // of the_object
+IPCV::ThreadPool thread_pool; // removes voxels by subfields if more than one thread
+std::vector< std::uint32_t > squared_distance; // to the background, of the voxels of binary_image
+bool keep_end_points = true; // anchors of the thinning by distance
 
 /// Register to polyscope the boundary surfels of a given binary image
 /// \a bimage.
@@ -69,37 +85,73 @@ void registerDigitalSurface( CountedPtr< SH3::BinaryImage > bimage,
   std::cout << "Make primal surface\n";
   auto primalSurface = SH3::makePrimalSurfaceMesh(surface);
   
-  std::vector<std::vector<size_t>> faces;
-  std::vector<RealPoint> positions;
-  //Need to convert the faces
-  for(size_t face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  //Recasting to vector of vertices
-  positions = primalSurface->positions();
-  // auto surfmesh = SurfMesh(positions.begin(),
-  //                          positions.end(),
-  //                          faces.begin(),
-  //                          faces.end());
+  //Faces as a flat array of quads
+  IPCV::QuadMesh< RealPoint > mesh;
+  mesh.append( *primalSurface );
+  // auto surfmesh = SurfMesh(mesh.positions.begin(),
+  //                          mesh.positions.end(),
+  //                          mesh.faces.begin(),
+  //                          mesh.faces.end());
   
   std::cout << "Register surface in polyscope\n";  
-  auto primalSurf = polyscope::registerSurfaceMesh( name, positions, faces);
+  auto primalSurf = polyscope::registerSurfaceMesh( name, mesh.positions, mesh.faces );
 }
 
-// Removes a peel of simple points onto voxel object.
+// Removes from voxel object and from the thinned image the voxels
+// removed by the last thinning step, and displays the result.
+void updateThinnedObject( CountedPtr< Z3i::Object26_6 > object )
+{
+  const std::size_t nb = thinning.removed().size();
+  const Point lo = thinned_image->domain().lowerBound();
+  const auto  e  = IPCV::extent( *thinned_image );
+  for ( auto i : thinning.removed() )
+    {
+      const Point p = lo + Point( int( i % e.nx ), int( ( i / e.nx ) % e.ny ),
+                                  int( i / ( e.nx * e.ny ) ) );
+      object->pointSet().erase( p );
+      thinned_image->setValue( p, false );
+    }
+  std::cout << nb << " voxels removed, " << thinning.size() << " left\n";
+  if ( nb > 0 ) registerDigitalSurface( thinned_image, "Thinned object" );
+}
+
+// Removes a peel of simple points onto voxel object. Only the border
+// voxels and the neighbors of removed voxels are examined, in parallel
+// by subfields if there are several threads.
+// @return 'true' when no point was removed, i.e. the thinning is over.
 bool oneStep( CountedPtr< Z3i::Object26_6 > object )
 {
-  /*
-  *
-  *
-  *
-  *  Main loop here
-  *
-  *
-  *
-  *
-  *
-  */
-  return true;
+  const std::size_t nb = thread_pool.size() > 1
+    ? thinning.oneStep( thread_pool ) : thinning.oneStep();
+  updateThinnedObject( object );
+  return nb == 0;
+}
+
+// Computes once the squared distances of the voxels of binary_image to
+// the background, with the separable distance transformation.
+void computeSquaredDistance()
+{
+  if ( ! squared_distance.empty() ) return;
+  std::cout << "Computing distance transformation\n";
+  Predicate predicate( *binary_image, 0 );
+  Z3i::L2Metric l2metric;
+  DT dt( binary_image->domain(), predicate, l2metric );
+  squared_distance.reserve( binary_image->domain().size() );
+  for ( const auto& p : binary_image->domain() )
+    squared_distance.push_back( std::uint32_t( ( p - dt.getVoronoiSite( p ) ).squaredNorm() ) );
+}
+
+// Removes all the simple points of voxel object in a single pass, by
+// increasing depth (squared distance to the background), keeping the
+// end points (voxels with only one 26-neighbor) if keep_end_points.
+void thinByDistance( CountedPtr< Z3i::Object26_6 > object )
+{
+  computeSquaredDistance();
+  const bool anchors = keep_end_points;
+  thinning.orderedThinning( [] ( std::size_t i ) { return squared_distance[ i ]; },
+                            [anchors] ( std::size_t, std::uint32_t c )
+                            { return anchors && std::popcount( c ) == 1; } );
+  updateThinnedObject( object );
 }
 
 // Polyscope GUI Callback
@@ -119,6 +171,11 @@ void mycallback()
       polyscope::refresh();
     }
   }
+  ImGui::Checkbox("Keep end points", &keep_end_points);
+  if (ImGui::Button("Thin by distance"))
+  {
+    thinByDistance( the_object );
+  }
 }
 
 // main program
@@ -128,8 +185,11 @@ int main( int argc, char* argv[] )
   
   CLI::App app{"Homotopic Thinning demo"};
   std::string filename;
+  int nb_threads = 0;
   app.add_option("-i,--input,1", filename, "Input VOL file")->required()->check(CLI::ExistingFile);
+  app.add_option("-j,--threads", nb_threads, "Number of threads of the thinning (0 means all hardware threads, 1 removes voxels sequentially)")->check(CLI::NonNegativeNumber);
   CLI11_PARSE(app,argc,argv);
+  thread_pool.resize( nb_threads );
   
   // Read voxel object and hands surfaces to polyscope
   auto params = SH3::defaultParameters()| SHG3::defaultParameters() | SHG3::parametersGeometryEstimation();
@@ -148,7 +208,12 @@ int main( int argc, char* argv[] )
     if ( (*binary_image)( p ) ) voxel_set.insert( p );
   
   the_object = CountedPtr< Z3i::Object26_6 >( new Z3i::Object26_6( dt26_6, voxel_set ) );
-  the_object->setTable(functions::loadTable<3>(simplicity::tableSimple26_6));
+  simple_table = functions::loadTable<3>(simplicity::tableSimple26_6);
+  the_object->setTable( simple_table );
+  thinned_image = CountedPtr< SH3::BinaryImage >( new SH3::BinaryImage( *binary_image ) );
+  const auto voxels = binary_image->begin();
+  thinning.init( [voxels] ( std::size_t i ) { return bool( voxels[ i ] ); },
+                 IPCV::extent( *binary_image ), *simple_table );
   
   // Give the hand to polyscope
   polyscope::state::userCallback = mycallback;
@@ -46,6 +46,7 @@
 
 #include "CLI11.hpp"
 
+#include "common/FlatMesh.h"
 
 using namespace DGtal;
 using namespace Z3i;
@@ -141,17 +142,14 @@ int main(int argc, char **argv)
   auto primalSurface = SH3::makePrimalSurfaceMesh(surface);
   
   //For the visualization of the digital surface.
-  std::vector<std::vector<size_t>> faces;
-  std::vector<RealPoint> positions;
-  for(size_t face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  positions = primalSurface->positions();
-  auto surfmesh = SurfMesh(positions.begin(),
-                           positions.end(),
-                           faces.begin(),
-                           faces.end());
+  IPCV::QuadMesh< RealPoint > mesh;
+  mesh.append( *primalSurface );
+  auto surfmesh = SurfMesh(mesh.positions.begin(),
+                           mesh.positions.end(),
+                           mesh.faces.begin(),
+                           mesh.faces.end());
   
-  polyscope::registerSurfaceMesh("Digital surface", positions, faces);
+  polyscope::registerSurfaceMesh("Digital surface", mesh.positions, mesh.faces);
   
   
   polyscope::state::userCallback = myCallback;
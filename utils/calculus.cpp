@@ -37,6 +37,9 @@
 #include <polyscope/polyscope.h>
 #include <polyscope/surface_mesh.h>
 #include <polyscope/point_cloud.h>
+
+#include "common/BackgroundJob.h"
+#include "common/FlatMesh.h"
 //#include <Eigen/Dense>
 //#include <Eigen/Sparse>
 
@@ -64,7 +67,7 @@ SHG3::RealVectors       iinormals;
 CountedPtr<SH3::DigitalSurface> surface;
 CountedPtr<SH3::BinaryImage>    binary_image;
 Parameters              params;
-std::vector<std::vector<SH3::SurfaceMesh::Vertex>> faces;
+std::vector< IPCV::QuadMesh< RealPoint >::Face > faces;
 std::vector< RealPoint > centroids;
 
 // Other global variables
@@ -73,6 +76,20 @@ float   radiusII = 3.0;
 float   scale    = 0.1;
 bool useCorrectedCalculus = false;
 
+IPCV::BackgroundWorker worker; // runs the computation of the quantities
+
+// The quantities computed in the background, displayed by showQuantities.
+struct Quantities {
+  std::vector< PolyCalculus::Real3dVector > projPos;
+  std::vector< std::vector< std::size_t > > projFaces;
+  std::vector< double > projPhi;
+  std::vector<PolyCalculus::Real3dVector> gradients;
+  std::vector<PolyCalculus::Vector> cogradients;
+  std::vector<PolyCalculus::Real3dVector> normals;
+  std::vector<PolyCalculus::Real3dVector> vectorArea;
+  std::vector<double> faceArea;
+} quantities;
+
 //Restriction of an ambient scalar function to vertices
 double phiVertex(const Vertex v)
 {
@@ -107,14 +124,16 @@ void initPhi()
   psMesh->addVertexScalarQuantity("Phi", phiV);
 }
 
-void initQuantities()
+// Runs in the background: polyscope is only used by the GUI thread.
+bool initQuantities( IPCV::JobControl& job )
 {
+  Quantities& Q = quantities;
+  Q = Quantities();
   if ( ptrCalculus != nullptr ) delete ptrCalculus;
   ptrCalculus = nullptr;
   if (!useCorrectedCalculus)
     {
       ptrCalculus = new PolyCalculus(surfmesh);
-      psProjMesh  = psMesh;
     }
   else
   {
@@ -122,73 +141,80 @@ void initQuantities()
     ptrCalculus = new PolyCalculus(surfmesh);
     functors::EmbedderFromNormalVectors<Z3i::RealPoint, Z3i::RealVector> embedderFromNormals(iinormals,surfmesh);
     ptrCalculus->setEmbedder( embedderFromNormals );
-    std::vector< PolyCalculus::Real3dVector > projPos;
-    std::vector< std::vector< std::size_t > > projFaces;
-    std::vector< double > projPhi;
     std::size_t idx = 0;
     for ( auto f = 0; f < faces.size(); f++ )
       {
         std::vector< std::size_t > vertices { idx, idx + 1, idx + 2, idx + 3 };
-        projFaces.push_back( vertices );
+        Q.projFaces.push_back( vertices );
         RealPoint c = RealPoint::zero;
         for ( auto v : faces[ f ] )
           {
-            projPhi.push_back( phiVertex( v ) );
+            Q.projPhi.push_back( phiVertex( v ) );
             auto ppos = embedderFromNormals( f, v );
-            projPos.push_back( ppos );
+            Q.projPos.push_back( ppos );
             c += ppos;
           }
         c   /= 4;
-        projPos[ idx++ ] += centroids[ f ] - c;
-        projPos[ idx++ ] += centroids[ f ] - c;
-        projPos[ idx++ ] += centroids[ f ] - c;
-        projPos[ idx++ ] += centroids[ f ] - c;
+        Q.projPos[ idx++ ] += centroids[ f ] - c;
+        Q.projPos[ idx++ ] += centroids[ f ] - c;
+        Q.projPos[ idx++ ] += centroids[ f ] - c;
+        Q.projPos[ idx++ ] += centroids[ f ] - c;
         //idx += 4;
       }
-    psProjMesh = polyscope::registerSurfaceMesh("Corrected surface", projPos, projFaces);
-    psProjMesh->addVertexScalarQuantity("Phi", projPhi);
   }
 
   PolyCalculus& calculus = *ptrCalculus;
 
-  std::vector<PolyCalculus::Real3dVector> gradients;
-  std::vector<PolyCalculus::Vector> cogradients;
-  std::vector<PolyCalculus::Real3dVector> normals;
-  std::vector<PolyCalculus::Real3dVector> vectorArea;
-  std::vector<PolyCalculus::Real3dPoint> centroids;
-  std::vector<double> faceArea;
-
-  for(auto f=0; f < surfmesh.nbFaces(); ++f)
+  const auto nbFaces = surfmesh.nbFaces();
+  for(auto f=0; f < nbFaces; ++f)
   {
+    if ( f % 1024 == 0 )
+      {
+        job.setProgress( double( f ) / double( nbFaces ) );
+        if ( job.isCancelled() ) return false;
+      }
     PolyCalculus::Vector ph = phiFace(f);
     PolyCalculus::Vector grad = calculus.gradient(f) * ph;
     PolyCalculus::Real3dVector G( grad[0], grad[1], grad[2] );
     // Fix length by projecting onto tangent plane
     // G *= tnormals[ f ].dot( iinormals[ f ] );
-    gradients.push_back( G * calculus.faceArea(f) );
+    Q.gradients.push_back( G * calculus.faceArea(f) );
     PolyCalculus::Vector cograd =  calculus.coGradient(f) * ph;
-    cogradients.push_back( cograd );
-    normals.push_back(calculus.faceNormalAsDGtalVector(f));
+    Q.cogradients.push_back( cograd );
+    Q.normals.push_back(calculus.faceNormalAsDGtalVector(f));
     
     auto vA = calculus.vectorArea(f);
-    vectorArea.push_back({vA(0) , vA(1), vA(2)});
+    Q.vectorArea.push_back({vA(0) , vA(1), vA(2)});
     
-    faceArea.push_back( calculus.faceArea(f));
+    Q.faceArea.push_back( calculus.faceArea(f));
     
     // centroids.push_back( calculus.centroidAsDGtalPoint(f) );
   }
+  return true;
+}
+
+void showQuantities()
+{
+  const Quantities& Q = quantities;
+  if (!useCorrectedCalculus)
+    psProjMesh  = psMesh;
+  else
+  {
+    psProjMesh = polyscope::registerSurfaceMesh("Corrected surface", Q.projPos, Q.projFaces);
+    psProjMesh->addVertexScalarQuantity("Phi", Q.projPhi);
+  }
   
-  psMesh->addFaceVectorQuantity("Gradients", gradients);
-  psMesh->addFaceVectorQuantity("co-Gradients", cogradients);
-  psMesh->addFaceVectorQuantity("Normals", normals);
-  psMesh->addFaceScalarQuantity("Face area", faceArea);
-  psMesh->addFaceVectorQuantity("Vector area", vectorArea);
+  psMesh->addFaceVectorQuantity("Gradients", Q.gradients);
+  psMesh->addFaceVectorQuantity("co-Gradients", Q.cogradients);
+  psMesh->addFaceVectorQuantity("Normals", Q.normals);
+  psMesh->addFaceScalarQuantity("Face area", Q.faceArea);
+  psMesh->addFaceVectorQuantity("Vector area", Q.vectorArea);
 
-  psProjMesh->addFaceVectorQuantity("Gradients", gradients);
-  psProjMesh->addFaceVectorQuantity("co-Gradients", cogradients);
-  psProjMesh->addFaceVectorQuantity("Normals", normals);
-  psProjMesh->addFaceScalarQuantity("Face area", faceArea);
-  psProjMesh->addFaceVectorQuantity("Vector area", vectorArea);
+  psProjMesh->addFaceVectorQuantity("Gradients", Q.gradients);
+  psProjMesh->addFaceVectorQuantity("co-Gradients", Q.cogradients);
+  psProjMesh->addFaceVectorQuantity("Normals", Q.normals);
+  psProjMesh->addFaceScalarQuantity("Face area", Q.faceArea);
+  psProjMesh->addFaceVectorQuantity("Vector area", Q.vectorArea);
   
   //polyscope::registerPointCloud("Centroids", centroids);
 }
@@ -196,23 +222,33 @@ void initQuantities()
 
 void myCallback()
 {
+  // Long computations run in the background, and only their status is
+  // displayed meanwhile.
+  if ( IPCV::jobStatus( worker ) ) return;
   ImGui::Checkbox( "Use corrected calculus", &useCorrectedCalculus );
   ImGui::SliderFloat("Phi scale", &scale, 0., 1.);
   if (ImGui::Button("Init phi"))
     initPhi();
   
   if (ImGui::Button("Compute quantities"))
-    initQuantities();
+    worker.start( "Computing quantities",
+                  [] ( IPCV::JobControl& job ) { return initQuantities( job ); },
+                  showQuantities );
 
   
   ImGui::SliderFloat("II radius", &radiusII , 0.,10.);
   if (ImGui::Button("Compute II normals"))
     {
       params("r-radius", (double) radiusII);
-      auto surfels   = SH3::getSurfelRange( surface, params );
-      iinormals = SHG3::getIINormalVectors( binary_image, surfels, params );
-      trace.info()<<iinormals.size()<<std::endl;
-      psMesh->addFaceVectorQuantity("II normals", iinormals);
+      worker.start( "Computing II normals",
+                    [] ( IPCV::JobControl& )
+                    {
+                      auto surfels   = SH3::getSurfelRange( surface, params );
+                      iinormals = SHG3::getIINormalVectors( binary_image, surfels, params );
+                      trace.info()<<iinormals.size()<<std::endl;
+                      return true;
+                    },
+                    [] { psMesh->addFaceVectorQuantity("II normals", iinormals); } );
     }
 }
 
@@ -230,12 +266,13 @@ int main()
   SH3::Cell2Index c2i;
   auto primalSurface   = SH3::makePrimalSurfaceMesh(c2i, surface);
   
-  // Convert faces to appropriate indexed format
-  for(auto face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
+  // Convert faces to a flat array of quads
+  IPCV::QuadMesh< RealPoint > mesh;
+  mesh.append( *primalSurface );
+  faces = std::move( mesh.faces );
   
   //Recasting to vector of vertices
-  auto positions = primalSurface->positions();
+  const auto& positions = mesh.positions;
 
   surfmesh = SurfMesh(positions.begin(),
                       positions.end(),
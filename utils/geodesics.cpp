@@ -41,6 +41,9 @@
 #include <polyscope/surface_mesh.h>
 #include <polyscope/point_cloud.h>
 
+#include "common/BackgroundJob.h"
+#include "common/FlatMesh.h"
+
 // #include <Eigen/Dense>
 // #include <Eigen/Sparse>
 
@@ -80,7 +83,11 @@ float radiusII = 3.0;
 bool skipReg = true; //Global flag to enable/disable the regularization example.
 bool useProjectedCalculus = true; //Use estimated normal vectors to set up te embedding
 
-void precompute()
+IPCV::BackgroundWorker worker; // runs the precomputation and the solvers
+GeodesicsInHeat<PolyCalculus>::Vector dist, distReg; // last computed geodesics
+
+// Runs in the background: polyscope is only used by the GUI thread.
+bool precompute( IPCV::JobControl& job )
 {
   
   if (!useProjectedCalculus)
@@ -93,7 +100,8 @@ void precompute()
     auto surfels   = SH3::getSurfelRange( surface, params2 );
     iinormals = SHG3::getIINormalVectors(binary_image, surfels,params2);
     trace.info()<<iinormals.size()<<std::endl;
-    psMesh->addFaceVectorQuantity("II normals", iinormals);
+    job.setProgress( 0.3 );
+    if ( job.isCancelled() ) return false;
     
     calculus = new PolyCalculus(surfmesh);
     functors::EmbedderFromNormalVectors<Z3i::RealPoint, Z3i::RealVector> embedderFromNormals(iinormals,surfmesh);
@@ -107,15 +115,17 @@ void precompute()
     calculusReg = new PolyCalculus(surfmeshReg);
     heatReg = new GeodesicsInHeat<PolyCalculus>(calculusReg);
   }
+  job.setProgress( 0.4 );
+  if ( job.isCancelled() ) return false;
   trace.beginBlock("Init solvers");
   heat->init(dt);
-  if (!skipReg)
+  job.setProgress( 0.7 );
+  if (!skipReg && !job.isCancelled())
     heatReg->init(dt);
   trace.endBlock();
+  return ! job.isCancelled();
 }
 
-
-
 void addSource()
 {
   auto pos =rand() % surfmesh.nbVertices();
@@ -137,27 +147,81 @@ void clearSources()
   psMesh->addVertexScalarQuantity("source", heat->source());
 }
 
-void computeGeodesics()
+/// Sets the sources of \a geodesics back to the vertices of \a previous.
+void restoreSources( GeodesicsInHeat<PolyCalculus>& geodesics,
+                     const GeodesicsInHeat<PolyCalculus>::Vector& previous )
 {
+  geodesics.clearSource();
+  for ( auto i = 0; i < previous.size(); ++i )
+    if ( previous( i ) != 0.0 ) geodesics.addSource( i );
+}
+
+// Runs in the background: the distances are displayed by showGeodesics.
+/// Adds the source and computes the geodesics. A cancelled job leaves
+/// the sources as they were before.
+bool computeGeodesics( IPCV::JobControl& job )
+{
+  const auto previous = heat->source();
   heat->addSource( sourceVertexId ); //Forcing one seed (for screenshots)
+  dist = heat->compute();
+  job.setProgress( 0.5 );
+  if ( job.isCancelled() )
+  {
+    restoreSources( *heat, previous );
+    return false;
+  }
+  if (!skipReg)
+  {
+    const auto previousReg = heatReg->source();
+    heatReg->addSource( sourceVertexId ); //Forcing one seed (for screenshots)371672
+    distReg = heatReg->compute();
+    if ( job.isCancelled() )
+    {
+      restoreSources( *heat, previous );
+      restoreSources( *heatReg, previousReg );
+      return false;
+    }
+  }
+  return true;
+}
+
+void showGeodesics()
+{
   GeodesicsInHeat<PolyCalculus>::Vector source = heat->source();
   psMesh->addVertexScalarQuantity("Sources", source);
-  GeodesicsInHeat<PolyCalculus>::Vector dist = heat->compute();
   psMesh->addVertexDistanceQuantity("geodesic", dist);
 
   if (!skipReg)
   {
-    heatReg->addSource( sourceVertexId ); //Forcing one seed (for screenshots)371672
     GeodesicsInHeat<PolyCalculus>::Vector sourceReg = heatReg->source();
     psMeshReg->addVertexScalarQuantity("Sources", sourceReg);
-    GeodesicsInHeat<PolyCalculus>::Vector dist = heatReg->compute();
-    psMeshReg->addVertexDistanceQuantity("geodesic", dist);
+    psMeshReg->addVertexDistanceQuantity("geodesic", distReg);
   }
 }
 
 bool isPrecomputed=false;
+
+/// Starts the precomputation in the background, then calls \a next
+/// (if any) on the GUI thread.
+void startPrecompute( std::function< void() > next )
+{
+  isPrecomputed = false; // until the job is complete
+  worker.start( "Precomputation",
+                [] ( IPCV::JobControl& job ) { return precompute( job ); },
+                [next]
+                {
+                  if (useProjectedCalculus)
+                    psMesh->addFaceVectorQuantity("II normals", iinormals);
+                  isPrecomputed = true;
+                  if ( next ) next();
+                } );
+}
+
 void myCallback()
 {
+  // Long computations run in the background, and only their status is
+  // displayed meanwhile.
+  if ( IPCV::jobStatus( worker ) ) return;
   ImGui::SliderFloat("dt", &dt, 0.,4.);
   ImGui::SliderFloat("ii radius for normal vector estimation", &radiusII , 0.,10.);
   ImGui::Checkbox("Skip regularization", &skipReg);
@@ -167,37 +231,36 @@ void myCallback()
   
   if(ImGui::Button("Precomputation (required if you change parameters)"))
   {
-    precompute();
-    isPrecomputed=true;
+    startPrecompute( nullptr );
   }
   ImGui::Separator();
   if(ImGui::Button("Add a random source"))
   {
     if (!isPrecomputed)
-    {
-      precompute();
-      isPrecomputed=true;
-    }
-    addSource();
+      startPrecompute( addSource );
+    else
+      addSource();
   }
   if(ImGui::Button("Clear sources"))
   {
     if (!isPrecomputed)
-    {
-      precompute();
-      isPrecomputed=true;
-    }
-    clearSources();
+      startPrecompute( clearSources );
+    else
+      clearSources();
   }
   
+  auto startGeodesics = []
+  {
+    worker.start( "Geodesics",
+                  [] ( IPCV::JobControl& job ) { return computeGeodesics( job ); },
+                  showGeodesics );
+  };
   if(ImGui::Button("Compute geodesic"))
   {
     if (!isPrecomputed)
-    {
-      precompute();
-      isPrecomputed=true;
-    }
-    computeGeodesics();
+      startPrecompute( startGeodesics );
+    else
+      startGeodesics();
   }
 }
 
@@ -212,15 +275,11 @@ int main( int argc, char* argv[] )
   surface              = SH3::makeDigitalSurface( binary_image, K, params );
   auto primalSurface   = SH3::makePrimalSurfaceMesh(surface);
   
-  //Need to convert the faces
-  std::vector<std::vector<SH3::SurfaceMesh::Vertex>> faces;
-  std::vector<RealPoint> positions;
-  
-  for(auto face= 0 ; face < primalSurface->nbFaces(); ++face)
-    faces.push_back(primalSurface->incidentVertices( face ));
-  
-  //Recasting to vector of vertices
-  positions = primalSurface->positions();
+  //Faces as a flat array of quads
+  IPCV::QuadMesh< RealPoint > mesh;
+  mesh.append( *primalSurface );
+  const auto& positions = mesh.positions;
+  const auto& faces     = mesh.faces;
 
   surfmesh = SurfMesh(positions.begin(),
                       positions.end(),
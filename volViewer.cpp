@@ -23,6 +23,8 @@
 #include <vector>
 #include <array>
 #include <utility>
+#include <algorithm>
+#include <memory>
 
 #include "CLI11.hpp"
 
@@ -31,6 +33,16 @@
 #include <DGtal/helpers/Shortcuts.h>
 #include <DGtal/helpers/ShortcutsGeometry.h>
 
+#include "common/MappedVolume.h"
+#include "common/PackedBinaryImage.h"
+#include "common/ThresholdCache.h"
+#include "common/ImageGenerations.h"
+#include "common/SliceView.h"
+#include "common/BackgroundJob.h"
+#include "common/FlatMesh.h"
+#include "common/MarchingCubes.h"
+#include "common/BlockRanges.h"
+#include "common/ThreadPool.h"
 
 #include "polyscope/polyscope.h"
 #include "polyscope/point_cloud.h"
@@ -44,21 +56,30 @@ using namespace Z3i;
 typedef Shortcuts<Z3i::KSpace>         SH3;
 typedef ShortcutsGeometry<Z3i::KSpace> SHG3;
 typedef SurfaceMesh< Z3i::RealPoint, Z3i::RealVector >         SurfMesh;
+typedef IPCV::PackedBinaryImage< Z3i::Domain >                 PackedImage;
 
 // Global variables
 KSpace                            K; // the space for the image
-CountedPtr< SH3::BinaryImage >    binary_image;
+CountedPtr< PackedImage >         binary_image;
+IPCV::ThresholdCache< KSpace, PackedImage > threshold_cache; // boundary of binary_image
 CountedPtr< SH3::GrayScaleImage > current_image;
 CountedPtr< SH3::GrayScaleImage > first_image;
 CountedPtr< SH3::GrayScaleImage > second_image;
+IPCV::ImageGenerations generations; // of the loaded images, keys of the caches
 Parameters params;
 
 // Global variables for GUI
 int threshold = 127;
 polyscope::SurfaceMesh* triSurf;
-polyscope::SurfaceMesh* sliceXSurf;
-polyscope::SurfaceMesh* sliceYSurf;
-polyscope::SurfaceMesh* sliceZSurf;
+IPCV::SliceView sliceXView; // slices are built once, then only
+IPCV::SliceView sliceYView; // moved and recolored
+IPCV::SliceView sliceZView;
+bool transposed = false;          // x-slices read from a transposed copy
+IPCV::TransposedVolume transposed_image; // of current_image
+IPCV::BackgroundWorker worker; // runs the surface extractions
+IPCV::ThreadPool thread_pool;  // threads used by the isosurface
+IPCV::BlockRanges block_ranges; // min/max of the blocks of the last extracted image
+bool iso_normals = false;      // isosurfaces get gradient normals
 int lx = -1;
 int ly = -1;
 int lz = -1;
@@ -72,89 +93,6 @@ bool refresh = true;
 int      img_choice = 0;
 int last_img_choice = -1;
 
-polyscope::SurfaceMesh*
-buildInitialSlice( std::string name, Point lo, Point up, int axis )
-{
-  Point slo = lo;
-  Point sup = up;
-  sup[ axis ] = lo[ axis ];
-  Point s = sup - slo + Point::diagonal(1);
-  Point t = s + Point::diagonal(1);
-  t[ axis ] = 1;
-  const int nb_faces    = s[ 0 ] * s[ 1 ] * s[ 2 ];
-  const int nb_vertices = t[ 0 ] * t[ 1 ] * t[ 2 ];
-  std::vector<RealPoint> positions( nb_vertices, RealPoint::zero );
-  int i = ( axis == 0 ) ? 1 : 0; // first axis
-  int j = ( axis == 2 ) ? 1 : 2; // second axis
-  int idx = 0;
-  RealPoint current;
-  current[ axis ] = lo[ axis ] + 0.5;
-  for ( int y = lo[ j ]; y <= up[ j ] + 1; y++ )
-    {
-      current[ j ] = y;
-      for ( int x = lo[ i ]; x <= up[ i ] + 1; x++ )
-        {
-          current[ i ] = x;
-          positions[ idx++ ] = current;
-        }
-    }
-  idx = 0;
-  std::vector<std::vector<size_t>> faces( nb_faces );
-  for ( int y = lo[ j ]; y <= up[ j ]; y++ )
-    for ( int x = lo[ i ]; x <= up[ i ]; x++ )
-      {
-        std::size_t ix = static_cast< std::size_t >( x - lo[ i ] );
-        std::size_t iy = static_cast< std::size_t >( y - lo[ j ] );
-        faces[ idx++ ] = std::vector<size_t>( {
-            t[ i ] * iy + ix,
-            t[ i ] * iy + ix + 1,
-            t[ i ] * ( iy + 1 ) + ix + 1,
-            t[ i ] * ( iy + 1 ) + ix
-          } );
-      }
-  return polyscope::registerSurfaceMesh( name, positions, faces);
-}
-  
-void
-updateSlice( CountedPtr<SH3::GrayScaleImage> image,
-             polyscope::SurfaceMesh* smesh, Point lo, Point up,
-             int axis, int pos )
-{
-  Point slo = lo;
-  Point sup = up;
-  sup[ axis ] = pos;
-  slo[ axis ] = pos;
-  Point   s = sup - slo + Point::diagonal(1);
-  Point   t = s + Point::diagonal(1);
-  t[ axis ] = 1;
-  const int nb_faces    = s[ 0 ] * s[ 1 ] * s[ 2 ];
-  const int nb_vertices = t[ 0 ] * t[ 1 ] * t[ 2 ];
-  std::vector<RealPoint> positions( nb_vertices );
-  int i = ( axis == 0 ) ? 1 : 0; // first axis
-  int j = ( axis == 2 ) ? 1 : 2; // second axis
-  int idx = 0;
-  RealPoint current;
-  current[ axis ] = pos + 0.5;
-  for ( int y = lo[ j ]; y <= up[ j ] + 1; y++ )
-    {
-      current[ j ] = y;
-      for ( int x = lo[ i ]; x <= up[ i ] + 1; x++ )
-        {
-          current[ i ] = x;
-          positions[ idx++ ] = current;
-        }
-    }
-  std::vector< double > colors( nb_faces );
-  Domain D( slo, sup );
-  idx = 0;
-  for ( auto p : D )
-    colors[ idx++ ] = (*image)(p);
-  smesh->updateVertexPositions( positions );
-  smesh->addFaceScalarQuantity( "image intensities", colors )
-    ->setMapRange( { 0.0, 255.0 } )
-    ->setEnabled( true );
-}
-
 // // Slower version
 // polyscope::SurfaceMesh*
 // buildSlice( std::string name, Point lo, Point up )
@@ -193,51 +131,81 @@ updateSlice( CountedPtr<SH3::GrayScaleImage> image,
 //   return sliceSurf;
 // }
 
-void extractDigitalSurface( CountedPtr<SH3::GrayScaleImage> image,
-                            int t, std::string label )
+// Meshes are built by a background job and registered in polyscope
+// by the GUI thread.
+typedef IPCV::QuadMesh< RealPoint >     QuadMesh;
+typedef IPCV::TriangleMesh< RealPoint > TriangleMesh;
+
+/// @return the blocks of \a image straddling \a t, computing the
+/// block ranges of \a image if they are not the current ones.
+IPCV::BlockMask activeBlocks( CountedPtr<SH3::GrayScaleImage> image, int t )
+{
+  const auto generation = generations( image->data() );
+  if ( ! block_ranges.isValid( generation ) )
+    block_ranges.init( image->data(), IPCV::extent( *image ), generation, thread_pool );
+  return block_ranges.activeBlocks( t );
+}
+
+/// Builds in \a mesh the digital surface of \a image thresholded at \a t.
+/// @return 'false' if \a job was cancelled meanwhile.
+bool extractDigitalSurface( CountedPtr<SH3::GrayScaleImage> image,
+                            int t, QuadMesh& mesh, IPCV::JobControl& job )
 {
   trace.beginBlock( "Extracting digital surface" );
   // Builds a thresholded image from a gray scale image
-  Domain domain = image->domain();
-  binary_image  = CountedPtr<SH3::BinaryImage>( new SH3::BinaryImage( domain ) );
-  std::transform( domain.begin(), domain.end(),
-                  binary_image->begin(),
-                  [&] ( const Point& p ) { return (*image)(p) > t; } );
-  auto surface = SH3::makeDigitalSurface( binary_image, K, params );
+  // The boundary is updated only around voxels between the previous
+  // and the new threshold, unless the image has changed.
+  const auto generation = generations( image->data() );
+  if ( binary_image.get() == nullptr || ! threshold_cache.isValid( generation ) )
+    {
+      binary_image  = CountedPtr<PackedImage>( new PackedImage( image->domain() ) );
+      binary_image->threshold( image->data(), t );
+      const auto blocks = activeBlocks( image, t );
+      threshold_cache.init( K, image->data(), generation, *binary_image, t, true, &blocks );
+    }
+  else
+    trace.info() << threshold_cache.setThreshold( t ) << " voxels changed" << std::endl;
+  SurfelAdjacency< 3 > surfAdj( params[ "surfelAdjacency" ].as<int>() );
+  auto surface = CountedPtr< SH3::DigitalSurface >
+    ( new SH3::DigitalSurface
+      ( new SH3::ExplicitSurfaceContainer( K, surfAdj, threshold_cache.surfels() ) ) );
   trace.endBlock();
+  job.setProgress( 0.3 );
+  if ( job.isCancelled() ) return false;
   trace.beginBlock( "Make primal surface" );
   auto primalSurface = SH3::makePrimalSurfaceMesh( surface );
   trace.endBlock();
-  trace.beginBlock( "Register surface in polyscope" );
-  std::vector<std::vector<size_t>> faces;
-  // Need to convert the faces
-  for( size_t face= 0 ; face < primalSurface->nbFaces(); ++face )
-    faces.push_back( primalSurface->incidentVertices( face ) );
-  std::vector<RealPoint> positions = primalSurface->positions();
-  auto primalSurf = polyscope::registerSurfaceMesh
-    ( "Digital surface " + label, positions, faces);
-  trace.endBlock();
+  job.setProgress( 0.8 );
+  mesh.append( *primalSurface );
+  return ! job.isCancelled();
 }
 
-void extractIsosurface( CountedPtr<SH3::GrayScaleImage> image,
-                        int t, std::string label )
+/// Builds in \a mesh the isosurface of \a image at \a t, and its
+/// normals if iso_normals.
+/// @return 'false' if \a job was cancelled meanwhile.
+bool extractIsosurface( CountedPtr<SH3::GrayScaleImage> image,
+                        int t, TriangleMesh& mesh, std::vector<RealVector>& normals,
+                        IPCV::JobControl& job )
 {
   trace.beginBlock( "Extract isosurface" );
-  auto tri  = SH3::makeTriangulatedSurface( image,
-                                            params( "thresholdMin", t ) );
-  trace.endBlock();
-  trace.beginBlock( "Register surface in polyscope" );
-  std::vector<std::vector<size_t>> faces;
-  // Need to convert the faces
-  for( size_t face= 0 ; face < tri->nbFaces(); ++face )
-    faces.push_back( tri->verticesAroundFace( face ) );
-  triSurf = polyscope::registerSurfaceMesh( "Isosurface " + label, tri->positions(), faces);
+  const Point lo = image->domain().lowerBound();
+  const auto blocks = activeBlocks( image, t );
+  trace.info() << blocks.count() << "/" << blocks.active.size() << " active blocks" << std::endl;
+  IPCV::MarchingCubes< RealPoint >::extract
+    ( image->data(), IPCV::extent( *image ), RealPoint( lo[ 0 ], lo[ 1 ], lo[ 2 ] ), t,
+      mesh, thread_pool, iso_normals ? &normals : nullptr, &blocks, job.stopFlag() );
+  trace.info() << mesh.positions.size() << " vertices, "
+               << mesh.nbFaces() << " triangles" << std::endl;
   trace.endBlock();
+  return ! job.isCancelled();
 }
 
 // Polyscope GUI Callback
 void mycallback()
 {
+  // Long actions run in the background, and only their status is
+  // displayed meanwhile.
+  if ( IPCV::jobStatus( worker ) ) return;
   ImGui::RadioButton("First image",  &img_choice, 0); ImGui::SameLine();
   ImGui::RadioButton("Second image", &img_choice, 1); 
   current_image = img_choice == 0 ? first_image : second_image;
@@ -246,15 +214,37 @@ void mycallback()
   std::string label = img_choice == 0 ? "1" : "2";
   
   ImGui::SliderInt("Threshold", &threshold, 0, 255 ); //, "ratio = %.3f");
+  // Surfaces are extracted in the background, then registered by the
+  // GUI thread.
   if (ImGui::Button("Isosurface"))
     {
-      extractIsosurface( current_image, threshold, label );
+      auto mesh    = std::make_shared< TriangleMesh >();
+      auto normals = std::make_shared< std::vector<RealVector> >();
+      worker.start( "Extracting isosurface",
+                    [mesh, normals, image = current_image, t = threshold] ( IPCV::JobControl& job )
+                    { return extractIsosurface( image, t, *mesh, *normals, job ); },
+                    [mesh, normals, label]
+                    {
+                      triSurf = polyscope::registerSurfaceMesh
+                        ( "Isosurface " + label, mesh->positions, mesh->faces );
+                      if ( ! normals->empty() )
+                        triSurf->addVertexVectorQuantity( "Gradient normals", *normals );
+                    } );
     }
   ImGui::SameLine();
   if (ImGui::Button("Digital surface"))
     {
-      extractDigitalSurface( current_image, threshold, label );
+      auto mesh = std::make_shared< QuadMesh >();
+      worker.start( "Extracting digital surface",
+                    [mesh, image = current_image, t = threshold] ( IPCV::JobControl& job )
+                    { return extractDigitalSurface( image, t, *mesh, job ); },
+                    [mesh, label]
+                    {
+                      polyscope::registerSurfaceMesh
+                        ( "Digital surface " + label, mesh->positions, mesh->faces );
+                    } );
     }
+  if ( worker.busy() ) return; // the job has just started
   Point lo = K.lowerBound();
   Point up = K.upperBound();
   ImGui::SliderInt("X", &x, lo[0], up[ 0 ] );
@@ -265,18 +255,23 @@ void mycallback()
   ImGui::Checkbox("Slice Y", &slice_y);
   ImGui::SameLine();
   ImGui::Checkbox("Slice Z", &slice_z);
+  if ( transposed && refresh )
+    transposed_image.init( current_image->data(), IPCV::extent( *current_image ) );
   if ( refresh || ( slice_x && (lx != x) ) )
-    updateSlice( current_image, sliceXSurf, lo, up, 0, x );
+    {
+      if ( transposed ) sliceXView.update( transposed_image, x - lo[ 0 ] );
+      else              sliceXView.update( current_image->data(), x - lo[ 0 ] );
+    }
   if ( refresh || ( slice_y && (ly != y) ) )
-    updateSlice( current_image, sliceYSurf, lo, up, 1, y );
+    sliceYView.update( current_image->data(), y - lo[ 1 ] );
   if ( refresh || ( slice_z && (lz != z) ) )
-    updateSlice( current_image, sliceZSurf, lo, up, 2, z );
+    sliceZView.update( current_image->data(), z - lo[ 2 ] );
   lx = x;
   ly = y;
   lz = z;
-  sliceXSurf->setEnabled( slice_x );
-  sliceYSurf->setEnabled( slice_y );
-  sliceZSurf->setEnabled( slice_z );
+  sliceXView.mesh()->setEnabled( slice_x );
+  sliceYView.mesh()->setEnabled( slice_y );
+  sliceZView.mesh()->setEnabled( slice_z );
   refresh = false;
 }
 
@@ -288,25 +283,35 @@ int main( int argc, char* argv[] )
   CLI::App app{"Homotopic Thinning demo"};
   std::string filename;
   std::string filename2;
+  bool companion = false;
   app.add_option("-i,--input,1", filename, "Input VOL file")->required()->check(CLI::ExistingFile);
   app.add_option("-2,--input2,1", filename2, "2nd Input VOL file")->check(CLI::ExistingFile);
+  app.add_flag("--mvol", companion, "Writes the uncompressed .mvol companion of input VOL files, which are loaded instead next time");
+  app.add_flag("--transposed", transposed, "Keeps a transposed copy of the displayed image, so that X-slices are read contiguously");
+  int nb_threads = 0;
+  app.add_option("-j,--threads", nb_threads, "Number of threads for isosurfaces (0 means all hardware threads)")->check(CLI::NonNegativeNumber);
+  app.add_flag("--normals", iso_normals, "Computes the gradient normals at the vertices of isosurfaces");
   CLI11_PARSE(app,argc,argv);
+  thread_pool.resize( nb_threads );
   
   // Read voxel object and hands surfaces to polyscope
   params = SH3::defaultParameters()| SHG3::defaultParameters() | SHG3::parametersGeometryEstimation();
   params( "closed", 1)("surfaceComponents", "All");
-  first_image  = SH3::makeGrayScaleImage( filename );
+  first_image  = IPCV::loadGrayScaleImage< SH3 >( filename, companion );
+  generations.touch( first_image->data() );
   std::cout << "Read image " << filename << "\n"; 
- second_image = (filename2 != "") ? SH3::makeGrayScaleImage( filename2 ) : first_image;  
+ second_image = (filename2 != "") ? IPCV::loadGrayScaleImage< SH3 >( filename2, companion ) : first_image;  
+  if ( filename2 != "" ) generations.touch( second_image->data() );
   K = SH3::getKSpace( first_image );
   Point lo = K.lowerBound();
   Point up = K.upperBound();
   std::cout << "Build KSpace lo=" << lo << " hi=" << up << "\n";
-  sliceXSurf = buildInitialSlice( "Slice X", lo, up, 0 );
+  const IPCV::Extent e = IPCV::extent( *first_image );
+  sliceXView.init( "Slice X", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 0 );
   std::cout << "Build slice X" << "\n";
-  sliceYSurf = buildInitialSlice( "Slice Y", lo, up, 1 );
+  sliceYView.init( "Slice Y", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 1 );
   std::cout << "Build slice Y" << "\n";
-  sliceZSurf = buildInitialSlice( "Slice Z", lo, up, 2 );
+  sliceZView.init( "Slice Z", e, { lo[ 0 ], lo[ 1 ], lo[ 2 ] }, 2 );
   std::cout << "Build slice Z" << "\n";
   // extractIsosurface( threshold ); 
   // Give the hand to polyscope